@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include "devices/ide.h"
 #include "threads/malloc.h"
+#include "threads/trace.h"
 
 /** A block device. */
 struct block
@@ -121,10 +122,39 @@ void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
   check_sector (block, sector);
+  trace (TRACE_DISK_START, 0, sector);
   block->ops->read (block->aux, sector, buffer);
+  trace (TRACE_DISK_FINISH, 0, sector);
   block->read_cnt++;
 }
 
+/** Reads CNT consecutive sectors starting at SECTOR from BLOCK,
+   the I-th one into BUFFERS[I], each of which must have room for
+   BLOCK_SECTOR_SIZE bytes.  Drivers that can transfer several
+   sectors with one command do so; others fall back to one
+   block_read() per sector. */
+void
+block_read_multi (struct block *block, block_sector_t sector,
+                  block_sector_t cnt, void *buffers[])
+{
+  block_sector_t i;
+
+  if (cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  if (block->ops->read_multi != NULL)
+    {
+      trace (TRACE_DISK_START, 0, sector);
+      block->ops->read_multi (block->aux, sector, cnt, buffers);
+      trace (TRACE_DISK_FINISH, 0, sector + cnt - 1);
+      block->read_cnt += cnt;
+    }
+  else
+    for (i = 0; i < cnt; i++)
+      block_read (block, sector + i, buffers[i]);
+}
+
 /** Write sector SECTOR to BLOCK from BUFFER, which must contain
    BLOCK_SECTOR_SIZE bytes.  Returns after the block device has
    acknowledged receiving the data.
@@ -135,7 +165,9 @@ block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
   check_sector (block, sector);
   ASSERT (block->type != BLOCK_FOREIGN);
+  trace (TRACE_DISK_START, TRACE_DISK_WRITE, sector);
   block->ops->write (block->aux, sector, buffer);
+  trace (TRACE_DISK_FINISH, TRACE_DISK_WRITE, sector);
   block->write_cnt++;
 }
 
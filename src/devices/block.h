@@ -52,6 +52,8 @@ struct block *block_next (struct block *);
 /** Block device operations. */
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
+void block_read_multi (struct block *, block_sector_t, block_sector_t cnt,
+                       void *buffers[]);
 void block_write (struct block *, block_sector_t, const void *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
@@ -65,6 +67,11 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Optional.  Reads CNT consecutive sectors with a single
+       command, the I-th one into BUFFERS[I]. */
+    void (*read_multi) (void *aux, block_sector_t, block_sector_t cnt,
+                        void *buffers[]);
   };
 
 struct block *block_register (const char *name, enum block_type,
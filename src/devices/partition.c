@@ -317,8 +317,19 @@ partition_write (void *p_, block_sector_t sector, const void *buffer)
   block_write (p->block, p->start + sector, buffer);
 }
 
+/** Reads CNT consecutive sectors starting at SECTOR from
+   partition P, the I-th one into BUFFERS[I]. */
+static void
+partition_read_multi (void *p_, block_sector_t sector, block_sector_t cnt,
+                      void *buffers[])
+{
+  struct partition *p = p_;
+  block_read_multi (p->block, p->start + sector, cnt, buffers);
+}
+
 static struct block_operations partition_operations =
   {
     partition_read,
-    partition_write
+    partition_write,
+    partition_read_multi
   };
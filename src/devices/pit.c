@@ -11,9 +11,6 @@
 #define PIT_PORT_CONTROL          0x43                /**< Control port. */
 #define PIT_PORT_COUNTER(CHANNEL) (0x40 + (CHANNEL))  /**< Counter port. */
 
-/** PIT cycles per second. */
-#define PIT_HZ 1193180
-
 /** Configure the given CHANNEL in the PIT.  In a PC, the PIT's
    three output channels are hooked up like this:
 
@@ -81,3 +78,45 @@ pit_configure_channel (int channel, int mode, int frequency)
   outb (PIT_PORT_COUNTER (channel), count >> 8);
   intr_set_level (old_level);
 }
+
+/** Starts CHANNEL counting down from COUNT once, in mode 0
+   ("interrupt on terminal count").  The channel's output is low
+   until the count runs out, then goes high, which on channel 0
+   raises a timer interrupt.  COUNT must be nonzero. */
+void
+pit_start_oneshot (int channel, uint16_t count)
+{
+  enum intr_level old_level;
+
+  ASSERT (channel == 0 || channel == 2);
+  ASSERT (count != 0);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, (channel << 6) | 0x30);
+  outb (PIT_PORT_COUNTER (channel), count);
+  outb (PIT_PORT_COUNTER (channel), count >> 8);
+  intr_set_level (old_level);
+}
+
+/** Returns the current count of CHANNEL, and stores in *OUT
+   whether its output is high.  Both are latched by a single
+   read-back command, so they are consistent with each other. */
+uint16_t
+pit_read_channel (int channel, bool *out)
+{
+  enum intr_level old_level;
+  uint8_t status, low, high;
+
+  ASSERT (channel == 0 || channel == 2);
+
+  old_level = intr_disable ();
+  outb (PIT_PORT_CONTROL, 0xc0 | (1 << (channel + 1)));
+  status = inb (PIT_PORT_COUNTER (channel));
+  low = inb (PIT_PORT_COUNTER (channel));
+  high = inb (PIT_PORT_COUNTER (channel));
+  intr_set_level (old_level);
+
+  if (out != NULL)
+    *out = (status & 0x80) != 0;
+  return low | (high << 8);
+}
@@ -7,6 +7,7 @@
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/tsc.h"
   
 /** See [8254] for hardware details of the 8254 timer chip. */
 
@@ -17,13 +18,88 @@
 #error TIMER_FREQ <= 1000 recommended
 #endif
 
-/** List of processes in THREAD_BLOCKED(SLEEP) state, that is, processes
-   that are blocked by calling sleep. */
-static struct list sleep_list;
+/** Pending kernel timers are kept in a hierarchical timing
+   wheel, so that arming a timer and expiring it are O(1) no
+   matter how many are pending.  The root wheel has a slot for
+   each of the next WHEEL_ROOT_SIZE ticks.  Each outer wheel
+   covers WHEEL_SIZE times the range of the one inside it, one
+   slot per span of the inner wheel; whenever the inner wheel
+   wraps around, the next slot of the outer wheel is cascaded,
+   that is, its timers are redistributed to the inner wheels.
+   Timers due further out than the outermost wheel reaches are
+   parked in it and cascaded again until they fit. */
+#define WHEEL_ROOT_BITS 8
+#define WHEEL_BITS 6
+#define WHEEL_ROOT_SIZE (1 << WHEEL_ROOT_BITS)
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_OUTER_CNT 3
+#define WHEEL_MAX_TICKS (1LL << (WHEEL_ROOT_BITS + WHEEL_OUTER_CNT * WHEEL_BITS))
+
+static struct list wheel_root[WHEEL_ROOT_SIZE];
+static struct list wheel_outer[WHEEL_OUTER_CNT][WHEEL_SIZE];
+
+/** Next tick whose timers have to be run.  Only timer_interrupt()
+   advances it, so it trails TICKS by at most one. */
+static int64_t wheel_ticks;
 
 /** Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/** Time-stamp counter when the timer was started, for
+   timer_tsc_freq(). */
+static uint64_t boot_tsc;
+
+/** Tickless idle.  When the idle thread is about to halt and no
+   timer expires on the next tick, timer_idle() switches the PIT
+   from periodic mode to a one-shot count that ends on the tick
+   boundary the next timer is due, so the CPU is not woken for
+   the ticks in between.  The ticks that were skipped are
+   accounted for, one at a time and on behalf of the idle
+   thread, as soon as any interrupt arrives: by timer_interrupt()
+   if the count ran out, otherwise by timer_idle_exit(), which
+   then runs one more one-shot count up to the next tick
+   boundary so the periodic ticks stay in phase.  The PIT's
+   16-bit counter limits each one-shot count to IDLE_MAX_TICKS.
+   There is no local APIC support, so this is PIT-only. */
+#define TIMER_CYCLES ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)  /**< PIT cycles per tick. */
+#define IDLE_MAX_TICKS (UINT16_MAX / TIMER_CYCLES)
+#define IDLE_MIN_CYCLES (TIMER_CYCLES / 16)
+
+enum timer_mode
+  {
+    TIMER_PERIODIC,             /**< Interrupting every tick. */
+    TIMER_IDLE,                 /**< One-shot count set by timer_idle(). */
+    TIMER_RESYNC,               /**< One-shot count to the next tick boundary. */
+    TIMER_HRES                  /**< One-shot count to a sleeper's deadline. */
+  };
+static enum timer_mode timer_mode;
+static int64_t idle_ticks;      /**< Ticks the TIMER_IDLE count spans. */
+static uint16_t idle_count;     /**< PIT cycles in the TIMER_IDLE count. */
+static uint16_t idle_first;     /**< PIT cycles to its first tick boundary. */
+static int64_t skipped_ticks;   /**< Ticks that took no interrupt. */
+
+/** High-resolution sleeps.  A sleep shorter than a tick neither
+   busy-waits nor goes on the wheel, whose granularity is one
+   tick: the sleeper goes on hres_sleepers, ordered by deadline in
+   PIT cycles since boot.  When the first deadline comes before the
+   next tick boundary, the PIT is switched to a one-shot count that
+   ends on it (TIMER_HRES).  Its interrupt wakes the sleepers that
+   are due and counts on to the next deadline, or to the tick
+   boundary (TIMER_RESYNC), so the periodic ticks stay in phase and
+   take no extra ticks.  Deadlines past the boundary are looked at
+   again on the tick. */
+#define HRES_MIN_CYCLES 64      /**< Shortest one-shot count worth its interrupt. */
+
+struct hres_sleeper
+  {
+    struct list_elem elem;      /**< Element in hres_sleepers. */
+    int64_t deadline;           /**< PIT cycle it is due on. */
+    struct thread *thread;      /**< The sleeping thread. */
+  };
+static struct list hres_sleepers;
+static uint16_t hres_left;      /**< PIT cycles from the TIMER_HRES count's end
+                                   to the next tick boundary. */
+
 /** Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -33,15 +109,35 @@ static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
 static void real_time_delay (int64_t num, int32_t denom);
+static void hres_sleep (int64_t cycles);
+static uint16_t hres_cycles_left (bool *pending);
+static void hres_program (uint16_t left);
+static bool hres_less (const struct list_elem *, const struct list_elem *,
+                       void *aux);
+static void wheel_insert (struct timer *);
+static void wheel_cascade (int level);
+static void wheel_run (void);
+static void wake_sleeper (struct timer *, void *thread);
+static int64_t wheel_next_expiry (int64_t max_ticks);
+static void timer_advance (void);
 
 /** Sets up the timer to interrupt TIMER_FREQ times per second,
    and registers the corresponding interrupt. */
 void
 timer_init (void) 
 {
+  int i, level;
+
+  for (i = 0; i < WHEEL_ROOT_SIZE; i++)
+    list_init (&wheel_root[i]);
+  for (level = 0; level < WHEEL_OUTER_CNT; level++)
+    for (i = 0; i < WHEEL_SIZE; i++)
+      list_init (&wheel_outer[level][i]);
+  list_init (&hres_sleepers);
+
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
-  list_init (&sleep_list);
+  boot_tsc = tsc_read ();
 }
 
 /** Calibrates loops_per_tick, used to implement brief delays. */
@@ -89,6 +185,19 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
+/** Returns the frequency of the time-stamp counter in Hz, as
+   measured against the timer since it was started, or 0 if no
+   tick has passed yet.  The estimate gets more precise the
+   longer the OS has been up. */
+uint64_t
+timer_tsc_freq (void)
+{
+  int64_t t = timer_ticks ();
+  if (t <= 0)
+    return 0;
+  return (tsc_read () - boot_tsc) * TIMER_FREQ / t;
+}
+
 /** Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
 void
@@ -99,18 +208,24 @@ timer_sleep (int64_t ticks)
 
   ASSERT (intr_get_level () == INTR_ON);
 
-  struct thread * t = thread_current ();
-  /** Disable interrupts to prevent the thread from jumping to other threads 
-     after setting block_ticks but before blocking.
-     Then block_ticks will not be decremented, resulting in incorrect sleep time. 
-     The sleep list is a critical resource */ 
+  struct timer timer;
+  timer_setup (&timer, wake_sleeper, thread_current ());
+
+  /* Interrupts are kept off from arming the timer until we have
+     blocked, so that it cannot try to wake us up before then. */
   enum intr_level old_level = intr_disable ();
-  t->ticks_blocked = timer_ticks () + ticks;
-  list_insert_ordered (&sleep_list, &t->elem, thread_less_ticks_blocked, NULL);
+  timer_start (&timer, ticks);
   thread_block ();
   intr_set_level (old_level);
 }
 
+/** Timer function for timer_sleep(): wakes up THREAD. */
+static void
+wake_sleeper (struct timer *timer UNUSED, void *thread)
+{
+  thread_unblock (thread);
+}
+
 /** Sleeps for approximately MS milliseconds.  Interrupts must be
    turned on. */
 void
@@ -174,11 +289,131 @@ timer_ndelay (int64_t ns)
   real_time_delay (ns, 1000 * 1000 * 1000);
 }
 
+/** Initializes TIMER, which is not armed, to call FUNC with AUX
+   when it expires. */
+void
+timer_setup (struct timer *timer, timer_func *func, void *aux)
+{
+  ASSERT (timer != NULL);
+  ASSERT (func != NULL);
+
+  timer->func = func;
+  timer->aux = aux;
+  timer->period = 0;
+  timer->pending = false;
+}
+
+/** Arms TIMER to expire once, TICKS timer ticks from now.  A
+   timer that is already armed is rearmed.  May be called from
+   an interrupt handler, including from the timer's own
+   function. */
+void
+timer_start (struct timer *timer, int64_t ticks)
+{
+  enum intr_level old_level = intr_disable ();
+  timer_cancel (timer);
+  timer->period = 0;
+  timer->expires = timer_ticks () + ticks;
+  wheel_insert (timer);
+  intr_set_level (old_level);
+}
+
+/** Arms TIMER to expire every PERIOD timer ticks from now on,
+   until it is cancelled. */
+void
+timer_start_periodic (struct timer *timer, int64_t period)
+{
+  ASSERT (period > 0);
+
+  enum intr_level old_level = intr_disable ();
+  timer_start (timer, period);
+  timer->period = period;
+  intr_set_level (old_level);
+}
+
+/** Disarms TIMER.  Returns true if it was pending, false if it
+   had already expired or was never armed.  Once this returns,
+   the timer's function is not running and will not be called
+   again unless the timer is rearmed. */
+bool
+timer_cancel (struct timer *timer)
+{
+  enum intr_level old_level = intr_disable ();
+  bool pending = timer->pending;
+  if (pending)
+    {
+      list_remove (&timer->elem);
+      timer->pending = false;
+    }
+  intr_set_level (old_level);
+  return pending;
+}
+
+/** Called by the idle thread, with interrupts off, just before
+   it halts the CPU.  Stops the periodic tick until the next
+   timer is due, if that is more than one tick away. */
+void
+timer_idle (void)
+{
+  int64_t delta;
+  uint16_t left;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (timer_mode != TIMER_PERIODIC || !list_empty (&hres_sleepers))
+    return;
+  delta = wheel_next_expiry (IDLE_MAX_TICKS);
+  if (delta < 2)
+    return;
+
+  /* Keep the periodic tick running if it is about to fire: its
+     interrupt may already be pending. */
+  left = pit_read_channel (0, NULL);
+  if (left < IDLE_MIN_CYCLES)
+    return;
+
+  idle_ticks = delta;
+  idle_first = left;
+  idle_count = left + (delta - 1) * TIMER_CYCLES;
+  pit_start_oneshot (0, idle_count);
+  timer_mode = TIMER_IDLE;
+}
+
+/** Called on entry to every external interrupt handler.  If the
+   interrupt woke the CPU from tickless idle before the one-shot
+   count ran out, accounts for the ticks that have passed and
+   resynchronizes the PIT with the tick boundaries. */
+void
+timer_idle_exit (void)
+{
+  uint16_t count, elapsed;
+  bool expired;
+  int64_t n;
+
+  ASSERT (intr_context ());
+
+  if (timer_mode != TIMER_IDLE)
+    return;
+  count = pit_read_channel (0, &expired);
+  if (expired)
+    return;     /* timer_interrupt() will take care of it. */
+
+  elapsed = idle_count - count;
+  n = elapsed < idle_first ? 0 : 1 + (elapsed - idle_first) / TIMER_CYCLES;
+  pit_start_oneshot (0, idle_first + n * TIMER_CYCLES - elapsed);
+  timer_mode = TIMER_RESYNC;
+
+  skipped_ticks += n;
+  while (n-- > 0)
+    timer_advance ();
+}
+
 /** Prints timer statistics. */
 void
 timer_print_stats (void) 
 {
-  printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  printf ("Timer: %"PRId64" ticks, %"PRId64" skipped while idle\n",
+          timer_ticks (), skipped_ticks);
 }
 
 
@@ -186,22 +421,35 @@ timer_print_stats (void)
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
-  struct list_elem* e;
-  struct thread* t;
+  if (timer_mode == TIMER_HRES)
+    {
+      /* A one-shot count ran out on a deadline, between ticks. */
+      hres_program (hres_left);
+      return;
+    }
+  if (timer_mode != TIMER_PERIODIC)
+    {
+      /* A one-shot count ran out, on a tick boundary. */
+      int64_t n = timer_mode == TIMER_IDLE ? idle_ticks : 1;
+
+      pit_configure_channel (0, 2, TIMER_FREQ);
+      timer_mode = TIMER_PERIODIC;
+      skipped_ticks += n - 1;
+      while (--n > 0)
+        timer_advance ();
+    }
+  timer_advance ();
+  if (!list_empty (&hres_sleepers))
+    hres_program (pit_read_channel (0, NULL));
+}
 
+/** Does the work of one timer tick. */
+static void
+timer_advance (void)
+{
   ticks++;
   thread_tick ();
-
-  /* Check sleep. */
-  while (!list_empty (&sleep_list))
-  {
-    e = list_front (&sleep_list);
-    t = list_entry (e, struct thread, elem);
-    if (t->ticks_blocked > timer_ticks ())
-      break;
-    list_remove (e);
-    thread_unblock (t);
-  }
+  wheel_run ();
 
   /* MLFQS check. */
   if (thread_mlfqs)
@@ -214,6 +462,120 @@ timer_interrupt (struct intr_frame *args UNUSED)
   }
 }
 
+/** Returns the number of ticks until the first tick on which a
+   timer may expire, counting the next tick as 1, or MAX_TICKS if
+   that is further away.  Slots of the root wheel hold only
+   timers for their own tick, but when the root wheel wraps
+   around timers cascade in from the outer wheels, so the search
+   stops there. */
+static int64_t
+wheel_next_expiry (int64_t max_ticks)
+{
+  int64_t delta;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (delta = 1; delta < max_ticks; delta++)
+    {
+      int64_t tick = wheel_ticks + delta - 1;
+      if (delta > 1 && tick % WHEEL_ROOT_SIZE == 0)
+        break;
+      if (!list_empty (&wheel_root[tick % WHEEL_ROOT_SIZE]))
+        break;
+    }
+  return delta;
+}
+
+/** Puts TIMER into the wheel slot for its expiry tick.  Timers
+   whose tick has already been run go into the slot run next. */
+static void
+wheel_insert (struct timer *timer)
+{
+  int64_t expires = timer->expires;
+  int64_t delta = expires - wheel_ticks;
+  struct list *slot;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (delta < 0)
+    slot = &wheel_root[wheel_ticks % WHEEL_ROOT_SIZE];
+  else if (delta < WHEEL_ROOT_SIZE)
+    slot = &wheel_root[expires % WHEEL_ROOT_SIZE];
+  else
+    {
+      int level;
+      int shift = WHEEL_ROOT_BITS;
+
+      if (delta >= WHEEL_MAX_TICKS)
+        expires = wheel_ticks + WHEEL_MAX_TICKS - 1;
+      for (level = 0; level < WHEEL_OUTER_CNT - 1; level++, shift += WHEEL_BITS)
+        if (delta < 1LL << (shift + WHEEL_BITS))
+          break;
+      slot = &wheel_outer[level][(expires >> shift) % WHEEL_SIZE];
+    }
+  list_push_back (slot, &timer->elem);
+  timer->pending = true;
+}
+
+/** Redistributes the timers in the current slot of outer wheel
+   LEVEL to the inner wheels.  If that slot is the first one,
+   the outer wheel has wrapped around too, so the next wheel out
+   is cascaded first. */
+static void
+wheel_cascade (int level)
+{
+  int shift = WHEEL_ROOT_BITS + level * WHEEL_BITS;
+  int idx = (wheel_ticks >> shift) % WHEEL_SIZE;
+  struct list *slot = &wheel_outer[level][idx];
+  struct list timers;
+
+  if (idx == 0 && level + 1 < WHEEL_OUTER_CNT)
+    wheel_cascade (level + 1);
+
+  list_init (&timers);
+  while (!list_empty (slot))
+    list_push_back (&timers, list_pop_front (slot));
+  while (!list_empty (&timers))
+    wheel_insert (list_entry (list_pop_front (&timers), struct timer, elem));
+}
+
+/** Runs the timers that expire on each tick up to the current
+   one, in the order they were armed for a given tick.  Periodic
+   timers are rearmed before their function is called, so that
+   the function may cancel them. */
+static void
+wheel_run (void)
+{
+  ASSERT (intr_context ());
+
+  while (wheel_ticks <= ticks)
+    {
+      struct list *slot = &wheel_root[wheel_ticks % WHEEL_ROOT_SIZE];
+      struct list expired;
+
+      if (wheel_ticks % WHEEL_ROOT_SIZE == 0)
+        wheel_cascade (0);
+
+      list_init (&expired);
+      while (!list_empty (slot))
+        list_push_back (&expired, list_pop_front (slot));
+      wheel_ticks++;
+
+      while (!list_empty (&expired))
+        {
+          struct timer *timer = list_entry (list_pop_front (&expired),
+                                            struct timer, elem);
+          timer->pending = false;
+          if (timer->period != 0)
+            {
+              timer->expires += timer->period;
+              wheel_insert (timer);
+            }
+          timer->func (timer, timer->aux);
+        }
+    }
+}
+
 /** Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -269,12 +631,123 @@ real_time_sleep (int64_t num, int32_t denom)
     }
   else 
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing. */
-      real_time_delay (num, denom); 
+      /* Otherwise, sleep on a one-shot count of the PIT for
+         more accurate sub-tick timing. */
+      hres_sleep (num * PIT_HZ / denom); 
+    }
+}
+
+/** Sleeps for CYCLES cycles of the PIT, less than a tick. */
+static void
+hres_sleep (int64_t cycles)
+{
+  struct hres_sleeper sleeper;
+  enum intr_level old_level;
+  uint16_t left;
+  bool pending;
+
+  if (cycles <= 0)
+    return;
+
+  /* As in timer_sleep(), interrupts stay off until we have
+     blocked. */
+  old_level = intr_disable ();
+  left = hres_cycles_left (&pending);
+  sleeper.deadline = (ticks + 1) * TIMER_CYCLES - left + cycles;
+  sleeper.thread = thread_current ();
+  list_insert_ordered (&hres_sleepers, &sleeper.elem, hres_less, NULL);
+
+  /* With the timer interrupt pending, it will do it soon enough. */
+  if (!pending)
+    hres_program (left);
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/** Returns the number of PIT cycles to the next tick boundary, and
+   sets *PENDING if the timer interrupt is pending, in which case
+   the counter is of no help: TICKS is about to be advanced (0 is
+   returned), or a TIMER_HRES count ran out. */
+static uint16_t
+hres_cycles_left (bool *pending)
+{
+  uint16_t count;
+  bool expired;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (timer_mode != TIMER_IDLE);
+
+  count = pit_read_channel (0, &expired);
+  switch (timer_mode)
+    {
+      case TIMER_PERIODIC:
+        *pending = intr_ext_pending (0x20);
+        return *pending ? 0 : count;
+
+      case TIMER_RESYNC:
+        *pending = expired;
+        return *pending ? 0 : count;
+
+      case TIMER_HRES:
+        *pending = expired;
+        return *pending ? hres_left : count + hres_left;
+
+      default:
+        NOT_REACHED ();
+    }
+}
+
+/** Wakes up the high-resolution sleepers that are due, LEFT PIT
+   cycles before the next tick boundary, and programs a one-shot
+   count to the next deadline if it comes before the boundary, or
+   else to the boundary if the PIT is not counting towards it. */
+static void
+hres_program (uint16_t left)
+{
+  int64_t now = (ticks + 1) * TIMER_CYCLES - left;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (!list_empty (&hres_sleepers))
+    {
+      struct hres_sleeper *s = list_entry (list_front (&hres_sleepers),
+                                           struct hres_sleeper, elem);
+      if (s->deadline > now)
+        break;
+      list_pop_front (&hres_sleepers);
+      thread_unblock (s->thread);
+    }
+
+  if (!list_empty (&hres_sleepers))
+    {
+      struct hres_sleeper *s = list_entry (list_front (&hres_sleepers),
+                                           struct hres_sleeper, elem);
+      int64_t delta = s->deadline - now;
+      if (delta + HRES_MIN_CYCLES <= left)
+        {
+          pit_start_oneshot (0, delta);
+          hres_left = left - delta;
+          timer_mode = TIMER_HRES;
+          return;
+        }
+    }
+  if (timer_mode == TIMER_HRES)
+    {
+      pit_start_oneshot (0, left);
+      timer_mode = TIMER_RESYNC;
     }
 }
 
+/** Orders hres_sleeper elements by deadline. */
+static bool
+hres_less (const struct list_elem *a_, const struct list_elem *b_,
+           void *aux UNUSED)
+{
+  const struct hres_sleeper *a = list_entry (a_, struct hres_sleeper, elem);
+  const struct hres_sleeper *b = list_entry (b_, struct hres_sleeper, elem);
+  return a->deadline < b->deadline;
+}
+
 /** Busy-wait for approximately NUM/DENOM seconds. */
 static void
 real_time_delay (int64_t num, int32_t denom)
@@ -1,17 +1,39 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /** Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/** A kernel timer, which calls FUNC with AUX once its expiry
+   tick has passed, and again every PERIOD ticks after that if
+   PERIOD is nonzero.  FUNC runs in the timer interrupt, so it
+   must not sleep; it typically wakes up a thread instead.  The
+   owner provides the storage, which must stay valid until the
+   timer has expired or has been cancelled. */
+struct timer;
+typedef void timer_func (struct timer *, void *aux);
+
+struct timer
+  {
+    struct list_elem elem;              /**< Element in a timer wheel slot. */
+    int64_t expires;                    /**< Tick on which it expires. */
+    int64_t period;                     /**< Ticks between expiries, 0 if one-shot. */
+    timer_func *func;                   /**< Function to call on expiry. */
+    void *aux;                          /**< Auxiliary data for FUNC. */
+    bool pending;                       /**< Armed and not yet expired? */
+  };
+
 void timer_init (void);
 void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+uint64_t timer_tsc_freq (void);
 
 /** Sleep and yield the CPU to other threads. */
 void timer_sleep (int64_t ticks);
@@ -24,6 +46,16 @@ void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
 void timer_ndelay (int64_t nanoseconds);
 
+/** Kernel timers. */
+void timer_setup (struct timer *, timer_func *, void *aux);
+void timer_start (struct timer *, int64_t ticks);
+void timer_start_periodic (struct timer *, int64_t period);
+bool timer_cancel (struct timer *);
+
+/** Tickless idle. */
+void timer_idle (void);
+void timer_idle_exit (void);
+
 void timer_print_stats (void);
 
 #endif /**< devices/timer.h */
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include <syscall.h>
 
 static void read_line (char line[], size_t);
+static void run_pipeline (char *command, char *bar);
 static bool backspace (char **pos, char line[]);
 
 int
@@ -30,6 +31,8 @@ main (void)
         {
           /* Empty command. */
         }
+      else if (strchr (command, '|') != NULL)
+        run_pipeline (command, strchr (command, '|'));
       else
         {
           pid_t pid = exec (command);
@@ -44,6 +47,53 @@ main (void)
   return EXIT_SUCCESS;
 }
 
+/** Runs the commands on either side of the '|' at BAR in COMMAND
+   at the same time, with the standard output of the first going
+   to the standard input of the second through a pipe. */
+static void
+run_pipeline (char *command, char *bar)
+{
+  char *cmds[2];
+  pid_t pids[2];
+  int fds[2];
+  int i;
+
+  *bar = '\0';
+  cmds[0] = command;
+  cmds[1] = bar + 1;
+  if (!pipe (fds))
+    {
+      printf ("pipe failed\n");
+      return;
+    }
+
+  /* A child starts with copies of our descriptors, so point our
+     stdout, then our stdin, at the pipe while starting it, and
+     get the console back by closing them.  The pipe's own
+     descriptors are kept from the children, so that each holds
+     only its end: the second sees end of file when the first
+     exits, and the first gets an error if the second exits early
+     instead of filling the pipe and blocking for good. */
+  set_cloexec (fds[0], true);
+  set_cloexec (fds[1], true);
+
+  dup2 (fds[1], STDOUT_FILENO);
+  pids[0] = exec (cmds[0]);
+  close (STDOUT_FILENO);
+  close (fds[1]);
+
+  dup2 (fds[0], STDIN_FILENO);
+  pids[1] = exec (cmds[1]);
+  close (STDIN_FILENO);
+  close (fds[0]);
+
+  for (i = 0; i < 2; i++)
+    if (pids[i] != PID_ERROR)
+      printf ("\"%s\": exit code %d\n", cmds[i], wait (pids[i]));
+    else
+      printf ("\"%s\": exec failed\n", cmds[i]);
+}
+
 /** Reads a line of input from the user into LINE, which has room
    for SIZE bytes.  Handles backspace and Ctrl+U in the ways
    expected by Unix users.  On return, LINE will always be
@@ -0,0 +1,48 @@
+/** syscall-bench.c
+
+   Measures the latency of a null system call, made with SYSENTER
+   and with "int $0x30", in time-stamp counter cycles.  The system
+   call is tell() on a file descriptor that is not open, for which
+   the kernel does no work beyond looking the descriptor up. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <syscall.h>
+
+#define CALL_CNT 100000
+
+/** Returns the time-stamp counter. */
+static uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/** Returns the average number of cycles a null system call takes. */
+static unsigned
+measure (void)
+{
+  uint64_t start;
+  int i;
+
+  start = rdtsc ();
+  for (i = 0; i < CALL_CNT; i++)
+    tell (-1);
+  return (rdtsc () - start) / CALL_CNT;
+}
+
+int
+main (void)
+{
+  if (syscall_sysenter)
+    {
+      printf ("sysenter: %u cycles per call\n", measure ());
+      syscall_sysenter = false;
+    }
+  else
+    printf ("sysenter: not supported\n");
+  printf ("int $0x30: %u cycles per call\n", measure ());
+  return EXIT_SUCCESS;
+}
@@ -1,11 +1,19 @@
 #include "filesys/cache.h"
+#include <string.h>
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
 
 #define WRITE_BACK_PERIOD 4 * TIMER_FREQ
 
+static struct timer write_back_timer;   /**< Fires every WRITE_BACK_PERIOD. */
+static struct semaphore write_back_due; /**< Upped by write_back_timer. */
+
+static void write_back_tick (struct timer *, void *);
+static int claim_cache_entry (block_sector_t, bool dirty);
+
 /** Init the cache of IDX. */
 void 
 init_entry(int idx)
@@ -22,9 +30,13 @@ init_cache(void)
 {
   int i;
   lock_init(&cache_lock);
+  lock_register(&cache_lock, "cache");
   for(i = 0; i < CACHE_MAX_SIZE; i++)
     init_entry(i);
 
+  sema_init(&write_back_due, 0);
+  timer_setup(&write_back_timer, write_back_tick, NULL);
+  timer_start_periodic(&write_back_timer, WRITE_BACK_PERIOD);
   thread_create("cache_writeback", PRI_MIN, func_periodic_writer, NULL);
 }
 
@@ -89,9 +101,23 @@ access_cache_entry(block_sector_t disk_sector, bool dirty)
    Second chance algorithm is used to evict the cache. */
 int 
 replace_cache_entry(block_sector_t disk_sector, bool dirty)
+{
+  int idx = claim_cache_entry(disk_sector, dirty);
+  block_read(fs_device, cache_array[idx].disk_sector, &cache_array[idx].block);
+
+  return idx;
+}
+
+/** Give DISK_SECTOR a cache entry, evicting one if need be, but
+   leave its contents unread: the caller is about to overwrite
+   them all. */
+static int
+claim_cache_entry(block_sector_t disk_sector, bool dirty)
 {
   int idx = get_free_entry();
   int i = 0;
+
+  trace(TRACE_CACHE_MISS, 0, disk_sector);
   if(idx == -1) /**< cache is full. */
   {
     for(i = 0; ; i = (i + 1) % CACHE_MAX_SIZE)
@@ -127,22 +153,85 @@ replace_cache_entry(block_sector_t disk_sector, bool dirty)
   cache_array[idx].open_cnt++;
   cache_array[idx].accessed = true;
   cache_array[idx].dirty = dirty;
-  block_read(fs_device, cache_array[idx].disk_sector, &cache_array[idx].block);
 
   return idx;
 }
 
+/** Copy all of sector SRC_SECTOR into the cache of DST_SECTOR,
+   without reading DST_SECTOR's old contents.  SRC_SECTOR comes
+   from its cache if it has one, and otherwise straight from disk,
+   without taking a cache entry of its own. */
+void
+copy_cache_sector(block_sector_t dst_sector, block_sector_t src_sector)
+{
+  lock_acquire(&cache_lock);
+
+  int dst = get_cache_entry(dst_sector);
+  if(dst == -1)
+    dst = claim_cache_entry(dst_sector, true);
+  else
+    cache_array[dst].open_cnt++;
+
+  int src = get_cache_entry(src_sector);
+  if(src != -1)
+  {
+    memcpy(cache_array[dst].block, cache_array[src].block, BLOCK_SECTOR_SIZE);
+    cache_array[src].accessed = true;
+  }
+  else
+    block_read(fs_device, src_sector, &cache_array[dst].block);
+
+  cache_array[dst].accessed = true;
+  cache_array[dst].dirty = true;
+  cache_array[dst].open_cnt--;
+
+  lock_release(&cache_lock);
+}
+
+/** Fill the cache of DST_SECTOR with sector SRC_SECTOR of device
+   SRC, read straight into the cache entry, without reading
+   DST_SECTOR's old contents. */
+void
+fill_cache_sector(block_sector_t dst_sector, struct block *src,
+                  block_sector_t src_sector)
+{
+  lock_acquire(&cache_lock);
+
+  int dst = get_cache_entry(dst_sector);
+  if(dst == -1)
+    dst = claim_cache_entry(dst_sector, true);
+  else
+    cache_array[dst].open_cnt++;
+
+  block_read(src, src_sector, &cache_array[dst].block);
+
+  cache_array[dst].accessed = true;
+  cache_array[dst].dirty = true;
+  cache_array[dst].open_cnt--;
+
+  lock_release(&cache_lock);
+}
+
 /** Write back the cache to disk periodically. */
 void
 func_periodic_writer(void *aux UNUSED)
 {
     while(true)
     {
-        timer_sleep(WRITE_BACK_PERIOD);
+        sema_down(&write_back_due);
         write_back(false);
     }
 }
 
+/** Runs in the timer interrupt, so just wakes the writer up.
+   Periods missed while it is busy collapse into one write back. */
+static void
+write_back_tick(struct timer *timer UNUSED, void *aux UNUSED)
+{
+    if(write_back_due.value == 0)
+        sema_up(&write_back_due);
+}
+
 /** Write back the dirty cache to disk. 
    If clear is true, clear the cache. */
 void 
@@ -28,6 +28,9 @@ int get_cache_entry(block_sector_t disk_sector);
 int get_free_entry(void);
 int access_cache_entry(block_sector_t disk_sector, bool dirty);
 int replace_cache_entry(block_sector_t disk_sector, bool dirty);
+void copy_cache_sector(block_sector_t dst_sector, block_sector_t src_sector);
+void fill_cache_sector(block_sector_t dst_sector, struct block *src,
+                       block_sector_t src_sector);
 void func_periodic_writer(void *aux);
 void write_back(bool clear);
 void func_read_ahead(void *aux);
@@ -4,6 +4,7 @@
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 
 /** A directory. */
@@ -11,6 +12,7 @@ struct dir
   {
     struct inode *inode;                /**< Backing store. */
     off_t pos;                          /**< Current position. */
+    int ref_cnt;                        /**< Holders, see dir_dup(). */
   };
 
 /** A single directory entry. */
@@ -39,6 +41,7 @@ dir_open (struct inode *inode)
     {
       dir->inode = inode;
       dir->pos = 0;
+      dir->ref_cnt = 1;
       return dir;
     }
   else
@@ -65,12 +68,30 @@ dir_reopen (struct dir *dir)
   return dir_open (inode_reopen (dir->inode));
 }
 
-/** Destroys DIR and frees associated resources. */
+/** Returns DIR itself, with one more holder, which shares its
+   position.  Each holder closes it once. */
+struct dir *
+dir_dup (struct dir *dir) 
+{
+  enum intr_level old_level = intr_disable ();
+  dir->ref_cnt++;
+  intr_set_level (old_level);
+  return dir;
+}
+
+/** Destroys DIR and frees associated resources, once its last
+   holder closes it. */
 void
 dir_close (struct dir *dir) 
 {
   if (dir != NULL)
     {
+      enum intr_level old_level = intr_disable ();
+      bool last = --dir->ref_cnt == 0;
+      intr_set_level (old_level);
+      if (!last)
+        return;
+
       inode_close (dir->inode);
       free (dir);
     }
@@ -124,12 +145,12 @@ dir_lookup (const struct dir *dir, const char *name,
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  inode_lock(dir_get_inode((struct dir *) dir));
+  inode_read_lock(dir_get_inode((struct dir *) dir));
   if (lookup (dir, name, &e, NULL))
     *inode = inode_open (e.inode_sector);
   else
     *inode = NULL;
-  inode_unlock(dir_get_inode((struct dir *) dir));
+  inode_read_unlock(dir_get_inode((struct dir *) dir));
 
   return *inode != NULL;
 }
@@ -241,18 +262,18 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
-  inode_lock(dir_get_inode(dir));
+  inode_read_lock(dir_get_inode(dir));
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-		      inode_unlock(dir_get_inode(dir));
+		      inode_read_unlock(dir_get_inode(dir));
           return true;
         } 
     }
-  inode_unlock(dir_get_inode(dir));
+  inode_read_unlock(dir_get_inode(dir));
   return false;
 }
 
@@ -18,6 +18,7 @@ bool dir_create (block_sector_t sector, size_t entry_cnt);
 struct dir *dir_open (struct inode *);
 struct dir *dir_open_root (void);
 struct dir *dir_reopen (struct dir *);
+struct dir *dir_dup (struct dir *);
 void dir_close (struct dir *);
 struct inode *dir_get_inode (struct dir *);
 int dir_get_inumber (struct dir*);
@@ -1,6 +1,7 @@
 #include "filesys/file.h"
 #include <debug.h>
 #include "filesys/inode.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 
 /** An open file. */
@@ -9,6 +10,7 @@ struct file
     struct inode *inode;        /**< File's inode. */
     off_t pos;                  /**< Current position. */
     bool deny_write;            /**< Has file_deny_write() been called? */
+    int ref_cnt;                /**< Holders, see file_dup(). */
   };
 
 /** Opens a file for the given INODE, of which it takes ownership,
@@ -23,6 +25,7 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ref_cnt = 1;
       return file;
     }
   else
@@ -41,12 +44,32 @@ file_reopen (struct file *file)
   return file_open (inode_reopen (file->inode));
 }
 
-/** Closes FILE. */
+/** Returns FILE itself, with one more holder: unlike
+   file_reopen(), the position is shared, as for descriptors
+   duplicated by dup2() or inherited by a child.  Each holder
+   closes it once. */
+struct file *
+file_dup (struct file *file) 
+{
+  /* The holders may be in different processes. */
+  enum intr_level old_level = intr_disable ();
+  file->ref_cnt++;
+  intr_set_level (old_level);
+  return file;
+}
+
+/** Closes FILE, once its last holder does. */
 void
 file_close (struct file *file) 
 {
   if (file != NULL)
     {
+      enum intr_level old_level = intr_disable ();
+      bool last = --file->ref_cnt == 0;
+      intr_set_level (old_level);
+      if (!last)
+        return;
+
       file_allow_write (file);
       inode_close (file->inode);
       free (file); 
@@ -113,6 +136,60 @@ file_write_at (struct file *file, const void *buffer, off_t size,
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/** Reads from FILE, starting at the file's current position,
+   into the IOVCNT buffers of IOV in turn.
+   Returns the number of bytes actually read,
+   which may be less than their total size if end of file is reached.
+   Advances FILE's position by the number of bytes read. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, int iovcnt)
+{
+  off_t bytes_read = inode_readv_at (file->inode, iov, iovcnt, file->pos);
+  file->pos += bytes_read;
+  return bytes_read;
+}
+
+/** Writes the IOVCNT buffers of IOV in turn into FILE,
+   starting at the file's current position.
+   Returns the number of bytes actually written.
+   Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, int iovcnt)
+{
+  off_t bytes_written = inode_writev_at (file->inode, iov, iovcnt, file->pos);
+  file->pos += bytes_written;
+  return bytes_written;
+}
+
+/** Copies SIZE bytes from SRC, starting at its current position,
+   into DST, starting at its current position, without passing
+   them through a caller's buffer.  SRC and DST must be open on
+   different inodes.
+   Returns the number of bytes actually copied,
+   which may be less than SIZE if end of SRC is reached.
+   Advances both files' positions by the number of bytes copied. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size)
+{
+  off_t bytes_copied = inode_copy_at (dst->inode, dst->pos,
+                                      src->inode, src->pos, size);
+  dst->pos += bytes_copied;
+  src->pos += bytes_copied;
+  return bytes_copied;
+}
+
+/** Writes SIZE bytes into FILE, starting at sector-aligned offset
+   FILE_OFS, taken from consecutive sectors of device SRC starting
+   at SRC_SECTOR, without passing them through memory of ours.
+   Returns the number of bytes actually written.
+   The file's current position is unaffected. */
+off_t
+file_write_from_block (struct file *file, off_t file_ofs, struct block *src,
+                       block_sector_t src_sector, off_t size)
+{
+  return inode_write_from_block (file->inode, file_ofs, src, src_sector, size);
+}
+
 /** Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
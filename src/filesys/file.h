@@ -1,13 +1,16 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include "devices/block.h"
 #include "filesys/off_t.h"
 
 struct inode;
+struct iovec;
 
 /** Opening and closing files. */
 struct file *file_open (struct inode *);
 struct file *file_reopen (struct file *);
+struct file *file_dup (struct file *);
 void file_close (struct file *);
 struct inode *file_get_inode (struct file *);
 int file_get_inumber (struct file*);
@@ -17,6 +20,11 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_readv (struct file *, const struct iovec *, int iovcnt);
+off_t file_writev (struct file *, const struct iovec *, int iovcnt);
+off_t file_copy (struct file *dst, struct file *src, off_t size);
+off_t file_write_from_block (struct file *, off_t file_ofs, struct block *src,
+                             block_sector_t src_sector, off_t size);
 
 /** Preventing writes. */
 void file_deny_write (struct file *);
@@ -3,10 +3,12 @@
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include <uio.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
 #include "filesys/cache.h"
+#include "threads/interrupt.h"
 #include "threads/synch.h"
 
 /** Identifies an inode. */
@@ -63,7 +65,8 @@ struct inode
     block_sector_t blocks[14];          /** Block pointers. */
     bool is_dir;                        /** True if directory. */
     block_sector_t parent;              /** Parent block sector. */
-    struct lock lock;                   /** Lock for inode. */
+    struct rwlock lock;                 /** Lock for the inode's metadata;
+                                            for directories, their entries. */
   };
 
 /* ADDED */
@@ -126,11 +129,19 @@ byte_to_sector (const struct inode *inode, off_t length, off_t pos)
    returns the same `struct inode'. */
 static struct list open_inodes;
 
+/** Protects open_inodes.  Lookups of inodes that are already
+   open only read the list, so they can proceed in parallel. */
+static struct rwlock open_inodes_lock;
+
+static struct inode *open_inodes_find (block_sector_t sector);
+
 /** Initializes the inode module. */
 void
 inode_init (void) 
 {
   list_init (&open_inodes);
+  rwlock_init (&open_inodes_lock);
+  lock_register (&open_inodes_lock.writer, "open inodes");
 }
 
 /** Initializes an inode with LENGTH bytes of data and
@@ -174,20 +185,14 @@ inode_create (block_sector_t sector, off_t length, bool is_dir)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
   struct inode *inode;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  rwlock_read_acquire (&open_inodes_lock);
+  inode = open_inodes_find (sector);
+  rwlock_read_release (&open_inodes_lock);
+  if (inode != NULL)
+    return inode;
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
@@ -197,12 +202,11 @@ inode_open (block_sector_t sector)
   /* Initialize. */
   struct inode_disk inode_disk;
 
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  lock_init(&inode->lock);
+  rwlock_init(&inode->lock);
 
   /* copy disk data to inode */
   block_read(fs_device, inode->sector, &inode_disk);
@@ -214,15 +218,49 @@ inode_open (block_sector_t sector)
   inode->is_dir = inode_disk.is_dir;
   inode->parent = inode_disk.parent;
   memcpy(&inode->blocks, &inode_disk.blocks, INODE_PTRS * sizeof(block_sector_t));
+
+  /* Someone else may have opened it in the meantime. */
+  rwlock_write_acquire (&open_inodes_lock);
+  struct inode *other = open_inodes_find (sector);
+  if (other == NULL)
+    list_push_front (&open_inodes, &inode->elem);
+  rwlock_write_release (&open_inodes_lock);
+  if (other != NULL)
+    {
+      free (inode);
+      return other;
+    }
   return inode;
 }
 
+/** Returns the open inode for SECTOR, reopened, or a null
+   pointer if it is not open.  open_inodes_lock must be held. */
+static struct inode *
+open_inodes_find (block_sector_t sector)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
+       e = list_next (e)) 
+    {
+      struct inode *inode = list_entry (e, struct inode, elem);
+      if (inode->sector == sector) 
+        return inode_reopen (inode);
+    }
+  return NULL;
+}
+
 /** Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      /* Other threads may be reopening it under the read lock. */
+      enum intr_level old_level = intr_disable ();
+      inode->open_cnt++;
+      intr_set_level (old_level);
+    }
   return inode;
 }
 
@@ -245,10 +283,16 @@ inode_close (struct inode *inode)
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  /* Release resources if this was the last opener.  The lock
+     is held until the inode is written back, so that reopening
+     it cannot read a stale copy from disk. */
+  rwlock_write_acquire (&open_inodes_lock);
+  enum intr_level old_level = intr_disable ();
+  bool last = --inode->open_cnt == 0;
+  intr_set_level (old_level);
+  if (last)
     {
-      /* Remove from inode list and release lock. */
+      /* Remove from inode list. */
       list_remove (&inode->elem);
  
       /* Deallocate blocks if removed. */
@@ -273,6 +317,7 @@ inode_close (struct inode *inode)
 
       free (inode); 
     }
+  rwlock_write_release (&open_inodes_lock);
 }
 
 /** Marks INODE to be deleted when it is closed by the last caller who
@@ -288,15 +333,23 @@ inode_remove (struct inode *inode)
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) 
 {
-  uint8_t *buffer = buffer_;
-  off_t bytes_read = 0;
+  struct iovec iov;
 
-  off_t length = inode->read_length;
+  iov.iov_base = buffer;
+  iov.iov_len = size;
+  return inode_readv_at (inode, &iov, 1, offset);
+}
 
-  if(offset >= length)
-    return 0;
+/** Reads SIZE bytes from INODE into BUFFER, starting at OFFSET,
+   with the file taken to be LENGTH bytes long.  The caller keeps
+   the block pointers from changing. */
+static off_t
+read_locked (struct inode *inode, uint8_t *buffer, off_t size, off_t offset,
+             off_t length)
+{
+  off_t bytes_read = 0;
 
   while (size > 0) 
     {
@@ -320,14 +373,44 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       cache_array[cache_idx].accessed = true;
       cache_array[cache_idx].open_cnt--;
 
-     
-      
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
+  return bytes_read;
+}
+
+/** Reads from INODE, starting at OFFSET, into the IOVCNT buffers
+   of IOV in turn, as one read of their total size would.  The
+   inode is locked once for the whole read.  Returns the number of
+   bytes actually read, which is less than the total only if end
+   of file is reached. */
+off_t
+inode_readv_at (struct inode *inode, const struct iovec *iov, int iovcnt,
+                off_t offset)
+{
+  off_t bytes_read = 0;
+  int i;
+
+  /* Keep the block pointers from changing under us while the
+     file grows.  Readers of a directory already hold its lock. */
+  if(!inode->is_dir)
+    rwlock_read_acquire(&inode->lock);
+
+  off_t length = inode->read_length;
+
+  for (i = 0; i < iovcnt; i++)
+    {
+      off_t n = read_locked (inode, iov[i].iov_base, iov[i].iov_len,
+                             offset + bytes_read, length);
+      bytes_read += n;
+      if (n < (off_t) iov[i].iov_len)
+        break;
+    }
 
+  if(!inode->is_dir)
+    rwlock_read_release(&inode->lock);
   return bytes_read;
 }
 
@@ -337,59 +420,239 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
    (Normally a write at end of file would extend the inode, but
    growth is not yet implemented.) */
 off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
                 off_t offset) 
 {
-  const uint8_t *buffer = buffer_;
+  struct iovec iov;
+
+  iov.iov_base = (void *) buffer;
+  iov.iov_len = size;
+  return inode_writev_at (inode, &iov, 1, offset);
+}
+
+/** Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+   which the inode has already grown to cover. */
+static off_t
+write_grown (struct inode *inode, const uint8_t *buffer, off_t size,
+             off_t offset)
+{
   off_t bytes_written = 0;
 
+  while (size > 0) 
+    {
+      /* Sector to write, starting byte offset within sector. */
+      block_sector_t sector_idx = byte_to_sector (inode, inode_length(inode),
+       offset);
+      int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+
+      /* Bytes left in inode, bytes left in sector, lesser of the two. */
+      off_t inode_left = inode_length (inode) - offset;
+      int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
+      int min_left = inode_left < sector_left ? inode_left : sector_left;
+
+      /* Number of bytes to actually write into this sector. */
+      int chunk_size = size < min_left ? size : min_left;
+      if (chunk_size <= 0)
+        break;
+
+      int cache_idx = access_cache_entry(sector_idx, true);
+      memcpy(cache_array[cache_idx].block + sector_ofs, buffer + bytes_written, chunk_size);
+      cache_array[cache_idx].accessed = true;
+      cache_array[cache_idx].dirty = true;
+      cache_array[cache_idx].open_cnt--;
+
+      /* Advance. */
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_written += chunk_size;
+    }
+  return bytes_written;
+}
+
+/** Writes the IOVCNT buffers of IOV in turn into INODE, starting
+   at OFFSET, as one write of their total size would.  The inode
+   is grown, under its lock, once for the whole write.  Returns
+   the number of bytes actually written. */
+off_t
+inode_writev_at (struct inode *inode, const struct iovec *iov, int iovcnt,
+                 off_t offset)
+{
+  off_t bytes_written = 0;
+  off_t size = 0;
+  int i;
+
   if (inode->deny_write_cnt)
     return 0;
 
+  for (i = 0; i < iovcnt; i++)
+    size += iov[i].iov_len;
+
   /* beyond EOF, need extend */
   if(offset + size > inode_length(inode))
   {
     // no sync required for dirs
     if(!inode->is_dir)
-      lock_acquire(&inode->lock);
+      rwlock_write_acquire(&inode->lock);
 
     inode->length = inode_grow(inode, offset + size);
 
     if(!inode->is_dir)
-      lock_release(&inode->lock);
+      rwlock_write_release(&inode->lock);
   }
 
+  for (i = 0; i < iovcnt; i++)
+    {
+      off_t n = write_grown (inode, iov[i].iov_base, iov[i].iov_len,
+                             offset + bytes_written);
+      bytes_written += n;
+      if (n < (off_t) iov[i].iov_len)
+        break;
+    }
+  inode->read_length = inode_length(inode);
+  return bytes_written;
+}
+
+/** Copies SIZE bytes of SRC, starting at SRC_OFS, into DST,
+   starting at DST_OFS, through the buffer cache.  Sectors that
+   are copied whole go from cache to cache, or straight from disk
+   into DST's cache, and never read DST's old contents.  SRC and
+   DST must not be the same inode.  Returns the number of bytes
+   actually copied, which is less than SIZE if end of SRC is
+   reached. */
+off_t
+inode_copy_at (struct inode *dst, off_t dst_ofs, struct inode *src,
+               off_t src_ofs, off_t size)
+{
+  off_t bytes_copied = 0;
+
+  ASSERT (dst != src);
+  if (dst->deny_write_cnt)
+    return 0;
+
+  /* SRC only grows, so its length now bounds the copy.  DST is
+     grown before SRC is locked, so that two copies in opposite
+     directions cannot deadlock. */
+  off_t length = src->read_length;
+  if (src_ofs >= length)
+    return 0;
+  if (size > length - src_ofs)
+    size = length - src_ofs;
+
+  if(dst_ofs + size > inode_length(dst))
+  {
+    rwlock_write_acquire(&dst->lock);
+    dst->length = inode_grow(dst, dst_ofs + size);
+    rwlock_write_release(&dst->lock);
+  }
+
+  rwlock_read_acquire(&src->lock);
+  while (size > 0) 
+    {
+      block_sector_t src_sector = byte_to_sector (src, length, src_ofs);
+      block_sector_t dst_sector = byte_to_sector (dst, inode_length(dst),
+       dst_ofs);
+      int src_sector_ofs = src_ofs % BLOCK_SECTOR_SIZE;
+      int dst_sector_ofs = dst_ofs % BLOCK_SECTOR_SIZE;
+
+      /* Bytes left in DST, bytes left in either sector, least of all. */
+      off_t dst_left = inode_length (dst) - dst_ofs;
+      int src_sector_left = BLOCK_SECTOR_SIZE - src_sector_ofs;
+      int dst_sector_left = BLOCK_SECTOR_SIZE - dst_sector_ofs;
+      int chunk_size = size < dst_left ? size : dst_left;
+      if (chunk_size > src_sector_left)
+        chunk_size = src_sector_left;
+      if (chunk_size > dst_sector_left)
+        chunk_size = dst_sector_left;
+      if (chunk_size <= 0)
+        break;
+
+      if (chunk_size == BLOCK_SECTOR_SIZE)
+        copy_cache_sector(dst_sector, src_sector);
+      else
+        {
+          int src_idx = access_cache_entry(src_sector, false);
+          int dst_idx = access_cache_entry(dst_sector, true);
+          memcpy(cache_array[dst_idx].block + dst_sector_ofs,
+                 cache_array[src_idx].block + src_sector_ofs, chunk_size);
+          cache_array[src_idx].accessed = true;
+          cache_array[src_idx].open_cnt--;
+          cache_array[dst_idx].accessed = true;
+          cache_array[dst_idx].dirty = true;
+          cache_array[dst_idx].open_cnt--;
+        }
+
+      /* Advance. */
+      size -= chunk_size;
+      src_ofs += chunk_size;
+      dst_ofs += chunk_size;
+      bytes_copied += chunk_size;
+    }
+  rwlock_read_release(&src->lock);
+
+  dst->read_length = inode_length(dst);
+  return bytes_copied;
+}
+
+/** Writes SIZE bytes into INODE, starting at OFFSET, which must be
+   sector-aligned, from consecutive sectors of device SRC starting
+   at SRC_SECTOR.  Whole sectors are read from SRC straight into
+   INODE's cache; only a partial last sector goes through a bounce
+   buffer, so that nothing past the end of the write reaches the
+   inode.  Returns the number of bytes actually written. */
+off_t
+inode_write_from_block (struct inode *inode, off_t offset, struct block *src,
+                        block_sector_t src_sector, off_t size)
+{
+  off_t bytes_written = 0;
+
+  ASSERT (offset % BLOCK_SECTOR_SIZE == 0);
+  if (inode->deny_write_cnt)
+    return 0;
+
+  if(offset + size > inode_length(inode))
+  {
+    rwlock_write_acquire(&inode->lock);
+    inode->length = inode_grow(inode, offset + size);
+    rwlock_write_release(&inode->lock);
+  }
 
   while (size > 0) 
     {
-      /* Sector to write, starting byte offset within sector. */
       block_sector_t sector_idx = byte_to_sector (inode, inode_length(inode),
        offset);
-      int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
+      /* Bytes left in inode, bytes left in sector, least of all. */
       off_t inode_left = inode_length (inode) - offset;
-      int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
-
-      /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
+      int chunk_size = size < inode_left ? size : inode_left;
+      if (chunk_size > BLOCK_SECTOR_SIZE)
+        chunk_size = BLOCK_SECTOR_SIZE;
       if (chunk_size <= 0)
         break;
 
-      int cache_idx = access_cache_entry(sector_idx, true);
-      memcpy(cache_array[cache_idx].block + sector_ofs, buffer + bytes_written, chunk_size);
-      cache_array[cache_idx].accessed = true;
-      cache_array[cache_idx].dirty = true;
-      cache_array[cache_idx].open_cnt--;
+      if (chunk_size == BLOCK_SECTOR_SIZE)
+        fill_cache_sector(sector_idx, src, src_sector);
+      else
+        {
+          uint8_t *bounce = malloc (BLOCK_SECTOR_SIZE);
+          if (bounce == NULL)
+            break;
+          block_read (src, src_sector, bounce);
+
+          int cache_idx = access_cache_entry(sector_idx, true);
+          memcpy(cache_array[cache_idx].block, bounce, chunk_size);
+          cache_array[cache_idx].accessed = true;
+          cache_array[cache_idx].dirty = true;
+          cache_array[cache_idx].open_cnt--;
+          free (bounce);
+        }
 
-      
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
+      src_sector++;
       bytes_written += chunk_size;
     }
-  // free (bounce);
+
   inode->read_length = inode_length(inode);
   return bytes_written;
 }
@@ -644,14 +907,26 @@ inode_set_parent (block_sector_t parent, block_sector_t child)
   return true;
 }
 
-/** Locks the inode. */
+/** Locks the inode, exclusively. */
 void inode_lock (const struct inode *inode)
 {
-  lock_acquire(&((struct inode *)inode)->lock);
+  rwlock_write_acquire(&((struct inode *)inode)->lock);
 }
 
-/** Unlocks the inode. */
+/** Unlocks the inode, locked by inode_lock(). */
 void inode_unlock (const struct inode *inode)
 {
-  lock_release(&((struct inode *) inode)->lock);
+  rwlock_write_release(&((struct inode *) inode)->lock);
+}
+
+/** Locks the inode for reading, shared with other readers. */
+void inode_read_lock (const struct inode *inode)
+{
+  rwlock_read_acquire(&((struct inode *)inode)->lock);
+}
+
+/** Unlocks the inode, locked by inode_read_lock(). */
+void inode_read_unlock (const struct inode *inode)
+{
+  rwlock_read_release(&((struct inode *) inode)->lock);
 }
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include "filesys/cache.h"
 
 struct bitmap;
+struct iovec;
 
 void inode_init (void);
 bool inode_create (block_sector_t, off_t, bool);
@@ -17,6 +18,14 @@ void inode_close (struct inode *);
 void inode_remove (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_readv_at (struct inode *, const struct iovec *, int iovcnt,
+                      off_t offset);
+off_t inode_writev_at (struct inode *, const struct iovec *, int iovcnt,
+                       off_t offset);
+off_t inode_copy_at (struct inode *dst, off_t dst_ofs, struct inode *src,
+                     off_t src_ofs, off_t size);
+off_t inode_write_from_block (struct inode *, off_t offset, struct block *src,
+                              block_sector_t src_sector, off_t size);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
@@ -30,5 +39,7 @@ block_sector_t inode_get_parent (const struct inode *);
 bool inode_set_parent (block_sector_t parent, block_sector_t child);
 void inode_lock (const struct inode *inode);
 void inode_unlock (const struct inode *inode);
+void inode_read_lock (const struct inode *inode);
+void inode_read_unlock (const struct inode *inode);
 
 #endif /**< filesys/inode.h */
@@ -0,0 +1,13 @@
+#ifndef __LIB_MMAN_H
+#define __LIB_MMAN_H
+
+/** Advice for the madvise() system call about how a range of a
+   mapping will be used. */
+#define MADV_NORMAL 0           /**< No special treatment. */
+#define MADV_RANDOM 1           /**< Random references: no readahead. */
+#define MADV_SEQUENTIAL 2       /**< Sequential references: read far ahead,
+                                     drop pages once passed. */
+#define MADV_WILLNEED 3         /**< Bring the pages in now. */
+#define MADV_DONTNEED 4         /**< Drop the pages now. */
+
+#endif /**< lib/mman.h */
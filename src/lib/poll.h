@@ -0,0 +1,24 @@
+#ifndef __LIB_POLL_H
+#define __LIB_POLL_H
+
+/** One thing for the poll() system call to watch. */
+struct pollfd
+  {
+    int fd;                     /**< File descriptor, ignored if negative;
+                                     with POLLEXIT, a child's pid. */
+    short events;               /**< Events to wait for. */
+    short revents;              /**< Events that happened. */
+  };
+
+/** Events. */
+#define POLLIN 0x001            /**< Data to read. */
+#define POLLOUT 0x004           /**< Room to write. */
+#define POLLERR 0x008           /**< Write end of a pipe with no readers. */
+#define POLLHUP 0x010           /**< Read end of a pipe with no writers. */
+#define POLLNVAL 0x020          /**< FD is not open, or not a child. */
+#define POLLEXIT 0x100          /**< Child FD has exited. */
+
+/** Most things that one poll() call may watch. */
+#define POLL_MAX 64
+
+#endif /**< lib/poll.h */
@@ -0,0 +1,20 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+#include <stdint.h>
+
+/** CPU time used by a process, as returned by the getrusage()
+   system call.  Times are measured with the time-stamp counter
+   and reported in microseconds. */
+struct rusage
+  {
+    int64_t utime;              /**< Time spent in user mode. */
+    int64_t stime;              /**< Time spent in the kernel. */
+  };
+
+/** Whose usage getrusage() reports. */
+#define RUSAGE_SELF 0           /**< The calling process. */
+#define RUSAGE_CHILDREN (-1)    /**< Its children that have been waited for,
+                                     and their waited-for descendants. */
+
+#endif /**< lib/rusage.h */
@@ -0,0 +1,33 @@
+#ifndef __LIB_SCHEDSTAT_H
+#define __LIB_SCHEDSTAT_H
+
+#include <stdint.h>
+
+/** Scheduler and lock contention statistics, as kept by the
+   kernel and returned by the schedstat() system call.  Times are
+   in timer ticks. */
+
+/** Per-thread counters. */
+struct thread_stat
+  {
+    int64_t run_ticks;              /**< Ticks spent running. */
+    unsigned voluntary_switches;    /**< Switches away because it blocked. */
+    unsigned involuntary_switches;  /**< Switches away while still ready. */
+    unsigned sema_waits;            /**< Times it blocked in sema_down(). */
+    int64_t sema_wait_ticks;        /**< Ticks spent blocked there. */
+  };
+
+/** Maximum length of a lock name in struct lock_stat. */
+#define LOCK_STAT_NAME_MAX 15
+
+/** Contention counters of a named kernel lock. */
+struct lock_stat
+  {
+    char name[LOCK_STAT_NAME_MAX + 1];  /**< Lock name, null-terminated. */
+    unsigned acquire_cnt;           /**< Number of acquisitions. */
+    unsigned contended_cnt;         /**< Acquisitions that had to wait. */
+    int64_t wait_ticks;             /**< Total ticks spent waiting. */
+    int64_t max_hold_ticks;         /**< Longest time it was held. */
+  };
+
+#endif /**< lib/schedstat.h */
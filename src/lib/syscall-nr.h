@@ -28,7 +28,27 @@ enum
     SYS_MKDIR,                  /**< Create a directory. */
     SYS_READDIR,                /**< Reads a directory entry. */
     SYS_ISDIR,                  /**< Tests if a fd represents a directory. */
-    SYS_INUMBER                 /**< Returns the inode number for a fd. */
+    SYS_INUMBER,                /**< Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FORK,                   /**< Duplicate this process. */
+    SYS_SCHEDSTAT,              /**< Get scheduling and lock statistics. */
+    SYS_GETRUSAGE,              /**< Get CPU time used. */
+    SYS_PREAD,                  /**< Read from a file at an offset. */
+    SYS_PWRITE,                 /**< Write to a file at an offset. */
+    SYS_READV,                  /**< Read into several buffers. */
+    SYS_WRITEV,                 /**< Write from several buffers. */
+    SYS_COPY_FILE_RANGE,        /**< Copy between files in the kernel. */
+    SYS_PIPE,                   /**< Create a pipe. */
+    SYS_DUP2,                   /**< Duplicate a file descriptor. */
+    SYS_POLL,                   /**< Wait for one of several events. */
+    SYS_SHM_MAP,                /**< Map a shared memory segment. */
+    SYS_MMAP_ANON,              /**< Map zero-filled memory. */
+    SYS_SBRK,                   /**< Grow or shrink the heap. */
+    SYS_MSYNC,                  /**< Write a file mapping back. */
+    SYS_MADVISE,                /**< Advise on the use of a range. */
+    SYS_MUNMAP_RANGE,           /**< Unmap part of a mapping. */
+    SYS_SET_CLOEXEC             /**< Keep a descriptor from exec(). */
   };
 
 #endif /**< lib/syscall-nr.h */
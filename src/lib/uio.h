@@ -0,0 +1,17 @@
+#ifndef __LIB_UIO_H
+#define __LIB_UIO_H
+
+#include <stddef.h>
+
+/** One buffer of a vectored read or write, as passed to the
+   readv() and writev() system calls. */
+struct iovec
+  {
+    void *iov_base;             /**< Start of the buffer. */
+    size_t iov_len;             /**< Its length in bytes. */
+  };
+
+/** Most buffers that one readv() or writev() call may take. */
+#define IOV_MAX 16
+
+#endif /**< lib/uio.h */
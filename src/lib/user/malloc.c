@@ -0,0 +1,395 @@
+#include <malloc.h>
+#include <debug.h>
+#include <limits.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/** malloc() for user programs, on top of sbrk().
+
+   It works like the kernel's (see threads/malloc.c).  The size of
+   each request is rounded up to a power of 2 and assigned to the
+   "descriptor" of that size class, which keeps a free list of
+   blocks of that size, so that most requests are served by
+   taking the first block of a list.  Otherwise, a new page-sized
+   "arena" is divided into blocks, all of which are added to the
+   free list.  When every block of an arena is free again, the
+   arena goes back to the heap.
+
+   Blocks bigger than 1 kB get a run of pages of their own, with
+   the page count in the arena header.
+
+   The pages of the heap are recycled through a list of the free
+   runs of pages, kept in address order and coalesced.  Pages are
+   taken from the first run big enough, and from sbrk() if there
+   is none; a run that ends where the heap does is given back
+   with sbrk().
+
+   A user process has a single thread, so nothing is locked. */
+
+#define PGSIZE 4096
+
+/** Descriptor. */
+struct desc
+  {
+    size_t block_size;          /**< Size of each element in bytes. */
+    size_t blocks_per_arena;    /**< Number of blocks in an arena. */
+    struct block *free_list;    /**< List of free blocks. */
+  };
+
+/** Magic number for detecting arena corruption. */
+#define ARENA_MAGIC 0x9a548eed
+
+/** Arena. */
+struct arena 
+  {
+    unsigned magic;             /**< Always set to ARENA_MAGIC. */
+    struct desc *desc;          /**< Owning descriptor, null for big block. */
+    size_t free_cnt;            /**< Free blocks; pages in big block. */
+  };
+
+/** Free block. */
+struct block 
+  {
+    struct block *prev, *next;  /**< Free list links. */
+  };
+
+/** Free run of pages of the heap, headed by this. */
+struct run
+  {
+    size_t page_cnt;            /**< Number of pages. */
+    struct run *next;           /**< Next run, at a higher address. */
+  };
+
+/** Our set of descriptors. */
+static struct desc descs[7];    /**< Descriptors. */
+static size_t desc_cnt;         /**< Number of descriptors. */
+
+/** Free runs of pages, in address order. */
+static struct run *free_runs;
+
+static void malloc_init (void);
+static void *get_pages (size_t page_cnt);
+static void put_pages (void *, size_t page_cnt);
+static struct arena *block_to_arena (struct block *);
+static struct block *arena_to_block (struct arena *, size_t idx);
+static void block_push (struct desc *, struct block *);
+static void block_remove (struct desc *, struct block *);
+
+/** Initializes the malloc() descriptors. */
+static void
+malloc_init (void) 
+{
+  size_t block_size;
+
+  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+    {
+      struct desc *d = &descs[desc_cnt++];
+      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
+      d->block_size = block_size;
+      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+      d->free_list = NULL;
+    }
+}
+
+/** Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size) 
+{
+  struct desc *d;
+  struct block *b;
+  struct arena *a;
+
+  /* A null pointer satisfies a request for 0 bytes. */
+  if (size == 0)
+    return NULL;
+
+  if (desc_cnt == 0)
+    malloc_init ();
+
+  /* Find the smallest descriptor that satisfies a SIZE-byte
+     request. */
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->block_size >= size)
+      break;
+  if (d == descs + desc_cnt) 
+    {
+      /* SIZE is too big for any descriptor.
+         Allocate enough pages to hold SIZE plus an arena. */
+      if (size > INT_MAX / 2)
+        return NULL;
+      size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
+      a = get_pages (page_cnt);
+      if (a == NULL)
+        return NULL;
+
+      /* Initialize the arena to indicate a big block of PAGE_CNT
+         pages, and return it. */
+      a->magic = ARENA_MAGIC;
+      a->desc = NULL;
+      a->free_cnt = page_cnt;
+      return a + 1;
+    }
+
+  /* If the free list is empty, create a new arena. */
+  if (d->free_list == NULL)
+    {
+      size_t i;
+
+      /* Allocate a page. */
+      a = get_pages (1);
+      if (a == NULL) 
+        return NULL; 
+
+      /* Initialize arena and add its blocks to the free list. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      for (i = 0; i < d->blocks_per_arena; i++) 
+        block_push (d, arena_to_block (a, i));
+    }
+
+  /* Get a block from free list and return it. */
+  b = d->free_list;
+  block_remove (d, b);
+  a = block_to_arena (b);
+  a->free_cnt--;
+  return b;
+}
+
+/** Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b) 
+{
+  void *p;
+  size_t size;
+
+  /* Calculate block size and make sure it fits in size_t. */
+  size = a * b;
+  if (b != 0 && size / b != a)
+    return NULL;
+
+  /* Allocate and zero memory. */
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+
+  return p;
+}
+
+/** Returns the number of bytes allocated for BLOCK. */
+static size_t
+block_size (void *block) 
+{
+  struct block *b = block;
+  struct arena *a = block_to_arena (b);
+  struct desc *d = a->desc;
+
+  return d != NULL ? d->block_size : PGSIZE * a->free_cnt - sizeof *a;
+}
+
+/** Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size) 
+{
+  if (new_size == 0) 
+    {
+      free (old_block);
+      return NULL;
+    }
+  else if (old_block != NULL && new_size <= block_size (old_block))
+    return old_block;
+  else 
+    {
+      void *new_block = malloc (new_size);
+      if (old_block != NULL && new_block != NULL)
+        {
+          memcpy (new_block, old_block, block_size (old_block));
+          free (old_block);
+        }
+      return new_block;
+    }
+}
+
+/** Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p) 
+{
+  if (p != NULL)
+    {
+      struct block *b = p;
+      struct arena *a = block_to_arena (b);
+      struct desc *d = a->desc;
+      
+      if (d != NULL) 
+        {
+          /* It's a normal block.  We handle it here. */
+
+#ifndef NDEBUG
+          /* Clear the block to help detect use-after-free bugs. */
+          memset (b, 0xcc, d->block_size);
+#endif
+
+          /* Add block to free list. */
+          block_push (d, b);
+
+          /* If the arena is now entirely unused, free it. */
+          if (++a->free_cnt >= d->blocks_per_arena) 
+            {
+              size_t i;
+
+              ASSERT (a->free_cnt == d->blocks_per_arena);
+              for (i = 0; i < d->blocks_per_arena; i++) 
+                block_remove (d, arena_to_block (a, i));
+              put_pages (a, 1);
+            }
+        }
+      else
+        {
+          /* It's a big block.  Free its pages. */
+          put_pages (a, a->free_cnt);
+        }
+    }
+}
+
+/** Returns PAGE_CNT contiguous pages of the heap, taken from the
+   free runs or, failing that, from the end of the heap.  Returns a
+   null pointer if the heap can't grow. */
+static void *
+get_pages (size_t page_cnt) 
+{
+  struct run **link;
+  uint8_t *brk;
+  size_t pad;
+
+  for (link = &free_runs; *link != NULL; link = &(*link)->next)
+    {
+      struct run *r = *link;
+      if (r->page_cnt > page_cnt)
+        {
+          /* Leave the rest of the run in its place. */
+          struct run *rest = (struct run *) ((uint8_t *) r + page_cnt * PGSIZE);
+          rest->page_cnt = r->page_cnt - page_cnt;
+          rest->next = r->next;
+          *link = rest;
+          return r;
+        }
+      else if (r->page_cnt == page_cnt)
+        {
+          *link = r->next;
+          return r;
+        }
+    }
+
+  /* Grow the heap, keeping arenas page-aligned. */
+  brk = sbrk (0);
+  pad = ROUND_UP ((uintptr_t) brk, PGSIZE) - (uintptr_t) brk;
+  if (sbrk (pad + page_cnt * PGSIZE) == (void *) -1)
+    return NULL;
+  return brk + pad;
+}
+
+/** Returns the PAGE_CNT pages at PAGES to the heap. */
+static void
+put_pages (void *pages, size_t page_cnt) 
+{
+  struct run *r = pages;
+  struct run **link = &free_runs, **prev_link = NULL;
+
+  /* Find where R goes: LINK points to the run after it, PREV_LINK
+     to the link to the one before. */
+  while (*link != NULL && *link < r)
+    {
+      prev_link = link;
+      link = &(*link)->next;
+    }
+
+  /* Insert R, merging it with its neighbours. */
+  r->page_cnt = page_cnt;
+  r->next = *link;
+  if (r->next != NULL
+      && (uint8_t *) r + r->page_cnt * PGSIZE == (uint8_t *) r->next)
+    {
+      r->page_cnt += r->next->page_cnt;
+      r->next = r->next->next;
+    }
+  *link = r;
+  if (prev_link != NULL
+      && (uint8_t *) *prev_link + (*prev_link)->page_cnt * PGSIZE == (uint8_t *) r)
+    {
+      struct run *prev = *prev_link;
+      prev->page_cnt += r->page_cnt;
+      prev->next = r->next;
+      r = prev;
+      link = prev_link;
+    }
+
+  /* The last run may end where the heap does: give it back. */
+  if (r->next == NULL && (uint8_t *) r + r->page_cnt * PGSIZE == sbrk (0))
+    {
+      *link = NULL;
+      sbrk (-(int) (r->page_cnt * PGSIZE));
+    }
+}
+
+/** Returns the arena that block B is inside. */
+static struct arena *
+block_to_arena (struct block *b)
+{
+  struct arena *a = (struct arena *) ((uintptr_t) b & ~(uintptr_t) (PGSIZE - 1));
+
+  /* Check that the arena is valid. */
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+
+  /* Check that the block is properly aligned for the arena. */
+  ASSERT (a->desc == NULL
+          || ((uint8_t *) b - (uint8_t *) a - sizeof *a) % a->desc->block_size == 0);
+  ASSERT (a->desc != NULL || (uint8_t *) b - (uint8_t *) a == sizeof *a);
+
+  return a;
+}
+
+/** Returns the (IDX - 1)'th block within arena A. */
+static struct block *
+arena_to_block (struct arena *a, size_t idx) 
+{
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+  ASSERT (idx < a->desc->blocks_per_arena);
+  return (struct block *) ((uint8_t *) a
+                           + sizeof *a
+                           + idx * a->desc->block_size);
+}
+
+/** Pushes B onto the front of D's free list. */
+static void
+block_push (struct desc *d, struct block *b) 
+{
+  b->prev = NULL;
+  b->next = d->free_list;
+  if (b->next != NULL)
+    b->next->prev = b;
+  d->free_list = b;
+}
+
+/** Removes B from D's free list. */
+static void
+block_remove (struct desc *d, struct block *b) 
+{
+  if (b->prev != NULL)
+    b->prev->next = b->next;
+  else
+    d->free_list = b->next;
+  if (b->next != NULL)
+    b->next->prev = b->prev;
+}
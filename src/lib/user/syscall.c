@@ -1,31 +1,66 @@
 #include <syscall.h>
+#include <stdint.h>
 #include "../syscall-nr.h"
 
+/** True if system calls enter the kernel with SYSENTER, false if
+   they use "int $0x30".  Set by syscall_probe(). */
+bool syscall_sysenter;
+
+/** Instructions that make a system call whose number and
+   arguments have been pushed on the stack.  SYSENTER does not save
+   the return address or stack pointer, so they are passed in
+   %edx and %ecx; the kernel's SYSEXIT resumes at label 2.  If
+   SYSENTER is not available, "int $0x30" is used instead. */
+#define SYSCALL_TRAP                                            \
+        "cmpb $0, syscall_sysenter; je 1f; "                    \
+        "movl %%esp, %%ecx; movl $2f, %%edx; sysenter; "        \
+        "1: int $0x30; 2: "
+
+/** Sets syscall_sysenter if the CPU supports SYSENTER, in which
+   case the kernel has enabled it.  Called by _start(). */
+void
+syscall_probe (void)
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+
+  /* CPUID(1).EDX bit 11 is SEP, but early Pentium Pros report
+     it without implementing SYSENTER.  See tss_enable_sysenter()
+     in userprog/tss.c. */
+  syscall_sysenter = ((edx & (1u << 11)) != 0
+                      && !(family == 6 && model < 3 && stepping < 3));
+}
+
 /** Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
 #define syscall0(NUMBER)                                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
-            ("pushl %[number]; int $0x30; addl $4, %%esp"       \
+            ("pushl %[number]; " SYSCALL_TRAP "addl $4, %%esp"  \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER)                          \
-               : "memory");                                     \
+               : "memory", "ecx", "edx");                       \
           retval;                                               \
         })
 
 /** Invokes syscall NUMBER, passing argument ARG0, and returns the
    return value as an `int'. */
-#define syscall1(NUMBER, ARG0)                                           \
-        ({                                                               \
-          int retval;                                                    \
-          asm volatile                                                   \
-            ("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp" \
-               : "=a" (retval)                                           \
-               : [number] "i" (NUMBER),                                  \
-                 [arg0] "g" (ARG0)                                       \
-               : "memory");                                              \
-          retval;                                                        \
+#define syscall1(NUMBER, ARG0)                                                \
+        ({                                                                    \
+          int retval;                                                         \
+          asm volatile                                                        \
+            ("pushl %[arg0]; pushl %[number]; " SYSCALL_TRAP "addl $8, %%esp" \
+               : "=a" (retval)                                                \
+               : [number] "i" (NUMBER),                                       \
+                 [arg0] "g" (ARG0)                                            \
+               : "memory", "ecx", "edx");                                     \
+          retval;                                                             \
         })
 
 /** Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
@@ -35,12 +70,12 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg1]; pushl %[arg0]; "                   \
-             "pushl %[number]; int $0x30; addl $12, %%esp"      \
+             "pushl %[number]; " SYSCALL_TRAP "addl $12, %%esp" \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
                  [arg1] "r" (ARG1)                              \
-               : "memory");                                     \
+               : "memory", "ecx", "edx");                       \
           retval;                                               \
         })
 
@@ -51,13 +86,32 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "    \
-             "pushl %[number]; int $0x30; addl $16, %%esp"      \
+             "pushl %[number]; " SYSCALL_TRAP "addl $16, %%esp" \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
                  [arg1] "r" (ARG1),                             \
                  [arg2] "r" (ARG2)                              \
-               : "memory");                                     \
+               : "memory", "ecx", "edx");                       \
+          retval;                                               \
+        })
+
+/** Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; "                 \
+             SYSCALL_TRAP "addl $20, %%esp"                     \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3)                              \
+               : "memory", "ecx", "edx");                       \
           retval;                                               \
         })
 
@@ -182,3 +236,111 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
+int
+schedstat (struct thread_stat *self, struct lock_stat *locks, int lock_cnt)
+{
+  return syscall3 (SYS_SCHEDSTAT, self, locks, lock_cnt);
+}
+
+int
+getrusage (int who, struct rusage *usage)
+{
+  return syscall2 (SYS_GETRUSAGE, who, usage);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+copy_file_range (int fd_in, int fd_out, unsigned size)
+{
+  return syscall3 (SYS_COPY_FILE_RANGE, fd_in, fd_out, size);
+}
+
+bool
+pipe (int fds[2])
+{
+  return syscall1 (SYS_PIPE, fds);
+}
+
+int
+dup2 (int old_fd, int new_fd)
+{
+  return syscall2 (SYS_DUP2, old_fd, new_fd);
+}
+
+bool
+set_cloexec (int fd, bool cloexec)
+{
+  return syscall2 (SYS_SET_CLOEXEC, fd, (int) cloexec);
+}
+
+int
+poll (struct pollfd *fds, int nfds, int timeout)
+{
+  return syscall3 (SYS_POLL, fds, nfds, timeout);
+}
+
+mapid_t
+shm_map (int key, unsigned size, void *addr)
+{
+  return syscall3 (SYS_SHM_MAP, key, size, addr);
+}
+
+mapid_t
+mmap_anon (void *addr, unsigned size)
+{
+  return syscall2 (SYS_MMAP_ANON, addr, size);
+}
+
+void *
+sbrk (int increment)
+{
+  return (void *) syscall1 (SYS_SBRK, increment);
+}
+
+bool
+msync (void *addr, unsigned length)
+{
+  return syscall2 (SYS_MSYNC, addr, length);
+}
+
+bool
+madvise (void *addr, unsigned length, int advice)
+{
+  return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+bool
+munmap_range (void *addr, unsigned length)
+{
+  return syscall2 (SYS_MUNMAP_RANGE, addr, length);
+}
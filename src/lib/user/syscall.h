@@ -3,6 +3,11 @@
 
 #include <stdbool.h>
 #include <debug.h>
+#include <mman.h>
+#include <poll.h>
+#include <rusage.h>
+#include <schedstat.h>
+#include <uio.h>
 
 /** Process identifier. */
 typedef int pid_t;
@@ -45,4 +50,28 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/** System call entry. */
+extern bool syscall_sysenter;
+void syscall_probe (void);
+
+/** Extensions. */
+pid_t fork (void);
+int schedstat (struct thread_stat *, struct lock_stat *, int lock_cnt);
+int getrusage (int who, struct rusage *);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int copy_file_range (int fd_in, int fd_out, unsigned length);
+bool pipe (int fds[2]);
+int dup2 (int old_fd, int new_fd);
+bool set_cloexec (int fd, bool cloexec);
+int poll (struct pollfd *, int nfds, int timeout);
+mapid_t shm_map (int key, unsigned size, void *addr);
+mapid_t mmap_anon (void *addr, unsigned size);
+void *sbrk (int increment);
+bool msync (void *addr, unsigned length);
+bool madvise (void *addr, unsigned length, int advice);
+bool munmap_range (void *addr, unsigned length);
+
 #endif /**< lib/user/syscall.h */
@@ -0,0 +1,75 @@
+/** Two threads of the same priority take turns acquiring and
+   releasing a lock, ITER_CNT times each.  Releasing the lock
+   wakes up the other thread if it is waiting, but that thread
+   does not outrank the releasing one, so it should not get the
+   CPU until the running thread's time slice runs out.  Counts
+   how often the lock changes hands between the threads, which
+   is the number of context switches the hand-offs caused, and
+   fails if that is more than a small fraction of ITER_CNT.
+   (Yielding on every release switches about 2 * ITER_CNT
+   times.) */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 2
+#define ITER_CNT 1000
+
+static thread_func pingpong_thread;
+static struct lock lock;
+static struct semaphore done;
+static int last_id = -1;
+static int switch_cnt;
+
+void
+test_priority_lock_pingpong (void) 
+{
+  static int ids[THREAD_CNT];
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  lock_init (&lock);
+  sema_init (&done, 0);
+
+  thread_set_priority (PRI_DEFAULT + 1);
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      char name[16];
+      ids[i] = i;
+      snprintf (name, sizeof name, "pingpong %d", i);
+      thread_create (name, PRI_DEFAULT, pingpong_thread, &ids[i]);
+    }
+  thread_set_priority (PRI_MIN);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  msg ("%d threads acquired the lock %d times each.", THREAD_CNT, ITER_CNT);
+  if (switch_cnt > ITER_CNT / 10)
+    fail ("lock changed hands %d times", switch_cnt);
+}
+
+static void
+pingpong_thread (void *id_) 
+{
+  int id = *(int *) id_;
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      lock_acquire (&lock);
+      if (last_id != id)
+        {
+          if (last_id != -1)
+            switch_cnt++;
+          last_id = id;
+        }
+      lock_release (&lock);
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-lock-pingpong) begin
+(priority-lock-pingpong) 2 threads acquired the lock 1000 times each.
+(priority-lock-pingpong) end
+EOF
+pass;
@@ -0,0 +1,60 @@
+/** Wakes up a wait queue on which a higher-priority thread waits
+   with two entries, as poll() does for two descriptors.  The
+   waiter runs as soon as it is woken up, removes its entries and
+   frees them before the waker is done with the queue. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define ENTRY_CNT 2
+
+static thread_func waiter_thread;
+static struct wait_queue wq;
+static struct semaphore ready;
+
+void
+test_priority_wait_queue (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  wait_queue_init (&wq);
+  sema_init (&ready, 0);
+  thread_create ("waiter", PRI_DEFAULT + 1, waiter_thread, NULL);
+  sema_down (&ready);
+
+  msg ("Waking up the queue.");
+  wait_queue_wake (&wq);
+  msg ("Main thread done waking.");
+}
+
+static void
+waiter_thread (void *aux UNUSED) 
+{
+  struct wait_queue_entry *entries;
+  struct semaphore wake;
+  int i;
+
+  entries = malloc (ENTRY_CNT * sizeof *entries);
+  if (entries == NULL)
+    PANIC ("out of memory");
+  sema_init (&wake, 0);
+  for (i = 0; i < ENTRY_CNT; i++)
+    wait_queue_add (&wq, &entries[i], &wake);
+
+  sema_up (&ready);
+  sema_down (&wake);
+  msg ("Waiter woke up.");
+
+  for (i = 0; i < ENTRY_CNT; i++)
+    wait_queue_remove (&entries[i]);
+  free (entries);
+  msg ("Waiter freed its entries.");
+}
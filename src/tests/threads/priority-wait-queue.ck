@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-wait-queue) begin
+(priority-wait-queue) Waking up the queue.
+(priority-wait-queue) Waiter woke up.
+(priority-wait-queue) Waiter freed its entries.
+(priority-wait-queue) Main thread done waking.
+(priority-wait-queue) end
+EOF
+pass;
@@ -0,0 +1,72 @@
+/** Copies between files with copy_file_range(), both whole sectors
+   and unaligned pieces, to a pipe that dup2() put on the standard
+   output, and from a file to the console. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE 2000
+
+static char data[SIZE];
+static char buf[SIZE];
+
+void
+test_main (void) 
+{
+  int src, dst, fd, n;
+  int fds[2];
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    data[i] = i % 251;
+  CHECK (create ("src", 0), "create \"src\"");
+  CHECK ((src = open ("src")) > 1, "open \"src\"");
+  CHECK (write (src, data, SIZE) == SIZE, "write \"src\"");
+  CHECK (create ("dst", 0), "create \"dst\"");
+  CHECK ((dst = open ("dst")) > 1, "open \"dst\"");
+
+  seek (src, 0);
+  if (copy_file_range (src, dst, SIZE * 2) != SIZE)
+    fail ("copy_file_range did not stop at end of file");
+  if (tell (src) != SIZE || tell (dst) != SIZE)
+    fail ("copy_file_range did not advance both file positions");
+  seek (dst, 0);
+  if (read (dst, buf, SIZE) != SIZE || memcmp (buf, data, SIZE))
+    fail ("whole copy has wrong data");
+  msg ("copy whole file");
+
+  seek (src, 100);
+  seek (dst, 7);
+  CHECK (copy_file_range (src, dst, 1000) == 1000, "copy unaligned range");
+  seek (dst, 0);
+  if (read (dst, buf, SIZE) != SIZE
+      || memcmp (buf, data, 7)
+      || memcmp (buf + 7, data + 100, 1000)
+      || memcmp (buf + 1007, data + 1007, SIZE - 1007))
+    fail ("unaligned copy has wrong data");
+  msg ("unaligned copy has right data");
+
+  CHECK (copy_file_range (src, src, 10) == -1, "copy to itself fails");
+  CHECK (copy_file_range (1, dst, 10) == -1, "copy from stdout fails");
+
+  /* No messages while stdout is the pipe. */
+  CHECK (pipe (fds), "pipe");
+  if (dup2 (fds[1], STDOUT_FILENO) != STDOUT_FILENO)
+    fail ("dup2 failed");
+  close (fds[1]);
+  seek (src, 0);
+  n = copy_file_range (src, STDOUT_FILENO, 100);
+  close (STDOUT_FILENO);
+  if (n != 100)
+    fail ("copy to stdout on a pipe returned %d", n);
+  if (read (fds[0], buf, SIZE) != 100 || memcmp (buf, data, 100))
+    fail ("pipe has wrong data");
+  msg ("copy to stdout on a pipe goes into the pipe");
+  close (fds[0]);
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  copy_file_range (fd, STDOUT_FILENO, SIZE);
+}
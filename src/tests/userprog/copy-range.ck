@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-range) begin
+(copy-range) create "src"
+(copy-range) open "src"
+(copy-range) write "src"
+(copy-range) create "dst"
+(copy-range) open "dst"
+(copy-range) copy whole file
+(copy-range) copy unaligned range
+(copy-range) unaligned copy has right data
+(copy-range) copy to itself fails
+(copy-range) copy from stdout fails
+(copy-range) pipe
+(copy-range) copy to stdout on a pipe goes into the pipe
+(copy-range) open "sample.txt"
+"Amazing Electronic Fact: If you scuffed your feet long enough without
+ touching anything, you would build up so many electrons that your
+ finger would explode!  But this is nothing to worry about unless you
+ have carpeting." --Dave Barry
+(copy-range) end
+copy-range: exit(0)
+EOF
+pass;
@@ -0,0 +1,34 @@
+/** Checks that getrusage() charges user-mode computation to user
+   time, system calls to system time, and the CPU time of a child
+   that has been waited for to the children's usage. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct rusage before, after, children;
+  volatile int sum = 0;
+  int i;
+
+  CHECK (getrusage (RUSAGE_SELF, &before) == 0, "getrusage");
+
+  for (i = 0; i < 10000000; i++)
+    sum += i;
+  for (i = 0; i < 1000; i++)
+    tell (0);
+
+  getrusage (RUSAGE_SELF, &after);
+  CHECK (after.utime > before.utime, "user time counted");
+  CHECK (after.stime > before.stime, "system time counted");
+
+  getrusage (RUSAGE_CHILDREN, &children);
+  CHECK (children.utime == 0 && children.stime == 0, "no children yet");
+  wait (exec ("child-simple"));
+  getrusage (RUSAGE_CHILDREN, &children);
+  CHECK (children.stime > 0, "child time counted");
+
+  CHECK (getrusage (1, &children) == -1, "bad who rejected");
+}
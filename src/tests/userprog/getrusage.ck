@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(getrusage) begin
+(getrusage) getrusage
+(getrusage) user time counted
+(getrusage) system time counted
+(getrusage) no children yet
+(child-simple) run
+child-simple: exit(81)
+(getrusage) child time counted
+(getrusage) bad who rejected
+(getrusage) end
+getrusage: exit(0)
+EOF
+pass;
@@ -0,0 +1,34 @@
+/** Opens many files, closes one in the middle, and checks that
+   the next open reuses the lowest free file descriptor. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 100
+
+void
+test_main (void) 
+{
+  int fds[FILE_CNT];
+  int i, fd;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      fds[i] = open ("sample.txt");
+      if (fds[i] < 3)
+        fail ("open #%d returned %d", i, fds[i]);
+      if (i > 0 && fds[i] != fds[i - 1] + 1)
+        fail ("open #%d returned %d, not %d", i, fds[i], fds[i - 1] + 1);
+    }
+  msg ("open %d files", FILE_CNT);
+
+  close (fds[FILE_CNT / 2]);
+  close (fds[FILE_CNT / 4]);
+  CHECK ((fd = open ("sample.txt")) == fds[FILE_CNT / 4],
+         "reopen gets lowest free fd");
+  CHECK ((fd = open ("sample.txt")) == fds[FILE_CNT / 2],
+         "reopen gets next free fd");
+  CHECK ((fd = open ("sample.txt")) == fds[FILE_CNT - 1] + 1,
+         "reopen gets fd past the end");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-lowest) begin
+(open-lowest) open 100 files
+(open-lowest) reopen gets lowest free fd
+(open-lowest) reopen gets next free fd
+(open-lowest) reopen gets fd past the end
+(open-lowest) end
+open-lowest: exit(0)
+EOF
+pass;
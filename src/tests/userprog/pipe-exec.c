@@ -0,0 +1,61 @@
+/** Passes data through a pipe within one process, then runs a
+   child with its standard output on a pipe and reads what it
+   printed, and checks that writing to a pipe nobody reads from
+   fails, that dup2() rejects descriptors out of range, and that a
+   file and its dup2() copy share their position. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fds[2];
+  char buf[64];
+  int n, total, fd;
+  pid_t child;
+
+  CHECK (pipe (fds), "pipe");
+  CHECK (write (fds[1], "hello", 5) == 5, "write 5 bytes");
+  if (read (fds[0], buf, sizeof buf) != 5 || memcmp (buf, "hello", 5))
+    fail ("read wrong data from pipe");
+  msg ("read them back");
+
+  /* No messages while stdout is the pipe. */
+  if (dup2 (fds[1], STDOUT_FILENO) != STDOUT_FILENO)
+    fail ("dup2 failed");
+  close (fds[1]);
+  child = exec ("child-simple");
+  close (STDOUT_FILENO);
+  CHECK (wait (child) == 81, "wait(exec()) with stdout on the pipe");
+
+  /* The child held the only write end, so end of file follows. */
+  total = 0;
+  while ((n = read (fds[0], buf + total, sizeof buf - 1 - total)) > 0)
+    total += n;
+  buf[total] = '\0';
+  if (strcmp (buf, "(child-simple) run\n"))
+    fail ("read \"%s\" from pipe", buf);
+  msg ("read child's output, then end of file");
+  close (fds[0]);
+
+  CHECK (pipe (fds), "pipe");
+  close (fds[0]);
+  CHECK (write (fds[1], "x", 1) == -1, "write with no reader fails");
+  CHECK (dup2 (fds[1], 0x7fffffff) == -1 && dup2 (fds[1], 1 << 29) == -1,
+         "dup2 to a huge descriptor fails");
+
+  CHECK (create ("shared", 0), "create \"shared\"");
+  CHECK ((fd = open ("shared")) > 2, "open \"shared\"");
+  CHECK (dup2 (fd, 20) == 20, "dup2 it to 20");
+  CHECK (write (fd, "ab", 2) == 2 && write (20, "cd", 2) == 2,
+         "write through both");
+  CHECK (tell (fd) == 4 && tell (20) == 4, "both are at the end");
+  seek (20, 0);
+  if (read (fd, buf, sizeof buf) != 4 || memcmp (buf, "abcd", 4))
+    fail ("writes through a dup2() copy overwrote each other");
+  msg ("writes through both were appended");
+}
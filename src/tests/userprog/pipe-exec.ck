@@ -0,0 +1,25 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-exec) begin
+(pipe-exec) pipe
+(pipe-exec) write 5 bytes
+(pipe-exec) read them back
+child-simple: exit(81)
+(pipe-exec) wait(exec()) with stdout on the pipe
+(pipe-exec) read child's output, then end of file
+(pipe-exec) pipe
+(pipe-exec) write with no reader fails
+(pipe-exec) dup2 to a huge descriptor fails
+(pipe-exec) create "shared"
+(pipe-exec) open "shared"
+(pipe-exec) dup2 it to 20
+(pipe-exec) write through both
+(pipe-exec) both are at the end
+(pipe-exec) writes through both were appended
+(pipe-exec) end
+pipe-exec: exit(0)
+EOF
+pass;
@@ -0,0 +1,41 @@
+/** Waits with poll() for data in a pipe, for a timeout, for a
+   child to exit, and for the write end of a pipe to close. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct pollfd pfds[2];
+  int fds[2];
+  char c;
+  pid_t child;
+
+  CHECK (pipe (fds), "pipe");
+  pfds[0].fd = fds[0];
+  pfds[0].events = POLLIN;
+  CHECK (poll (pfds, 1, 50) == 0, "poll of empty pipe times out");
+  CHECK (write (fds[1], "x", 1) == 1, "write 1 byte");
+  CHECK (poll (pfds, 1, -1) == 1 && pfds[0].revents == POLLIN,
+         "poll sees data");
+  CHECK (read (fds[0], &c, 1) == 1, "read 1 byte");
+
+  /* No messages until the child is done with its own. */
+  if ((child = exec ("child-simple")) == -1)
+    fail ("exec child-simple failed");
+  pfds[1].fd = child;
+  pfds[1].events = POLLEXIT;
+  CHECK (poll (pfds, 2, -1) == 1
+         && pfds[0].revents == 0 && pfds[1].revents == POLLEXIT,
+         "poll sees child exit");
+  CHECK (wait (child) == 81, "wait for child");
+
+  close (fds[1]);
+  CHECK (poll (pfds, 1, 0) == 1 && pfds[0].revents == POLLHUP,
+         "poll sees write end closed");
+  pfds[0].fd = 100;
+  CHECK (poll (pfds, 1, 0) == 1 && pfds[0].revents == POLLNVAL,
+         "poll of bad fd");
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(poll) begin
+(poll) pipe
+(poll) poll of empty pipe times out
+(poll) write 1 byte
+(poll) poll sees data
+(poll) read 1 byte
+(child-simple) run
+child-simple: exit(81)
+(poll) poll sees child exit
+(poll) wait for child
+(poll) poll sees write end closed
+(poll) poll of bad fd
+(poll) end
+poll: exit(0)
+EOF
+pass;
@@ -0,0 +1,67 @@
+/** Reads sample.txt with pread() and readv(), writes a new file
+   with writev() and pwrite(), and checks that only readv() and
+   writev() move the file position. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  char head[7], tail[sizeof sample];
+  struct iovec iov[3];
+  size_t size = sizeof sample - 1;
+  int fd;
+
+  CHECK ((fd = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  if (pread (fd, buf, 10, 20) != 10)
+    fail ("pread returned wrong size");
+  if (memcmp (buf, sample + 20, 10))
+    fail ("pread read wrong data");
+  if (tell (fd) != 0)
+    fail ("pread moved the file position");
+  msg ("pread");
+
+  iov[0].iov_base = head;
+  iov[0].iov_len = sizeof head;
+  iov[1].iov_base = NULL;
+  iov[1].iov_len = 0;
+  iov[2].iov_base = tail;
+  iov[2].iov_len = sizeof tail;
+  if (readv (fd, iov, 3) != (int) size)
+    fail ("readv returned wrong size");
+  if (memcmp (head, sample, sizeof head)
+      || memcmp (tail, sample + sizeof head, size - sizeof head))
+    fail ("readv read wrong data");
+  if (tell (fd) != size)
+    fail ("readv did not advance the file position");
+  msg ("readv");
+
+  CHECK (readv (fd, iov, IOV_MAX + 1) == -1, "readv of too many buffers");
+
+  CHECK (create ("vec.txt", 0), "create \"vec.txt\"");
+  CHECK ((fd = open ("vec.txt")) > 1, "open \"vec.txt\"");
+  iov[0].iov_base = (char *) sample;
+  iov[0].iov_len = 10;
+  iov[1].iov_base = (char *) sample + 10;
+  iov[1].iov_len = size - 10;
+  if (writev (fd, iov, 2) != (int) size)
+    fail ("writev returned wrong size");
+  if (pwrite (fd, "Dull", 4, 11) != 4)
+    fail ("pwrite returned wrong size");
+  if (tell (fd) != size)
+    fail ("pwrite moved the file position");
+  msg ("writev and pwrite");
+
+  memset (buf, 0, sizeof buf);
+  if (pread (fd, buf, sizeof buf, 0) != (int) size)
+    fail ("pread returned wrong size");
+  if (memcmp (buf, sample, 11) || memcmp (buf + 11, "Dull", 4)
+      || memcmp (buf + 15, sample + 15, size - 15))
+    fail ("file has wrong data");
+  msg ("pread sees both writes");
+}
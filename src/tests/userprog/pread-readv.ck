@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-readv) begin
+(pread-readv) open "sample.txt"
+(pread-readv) pread
+(pread-readv) readv
+(pread-readv) readv of too many buffers
+(pread-readv) create "vec.txt"
+(pread-readv) open "vec.txt"
+(pread-readv) writev and pwrite
+(pread-readv) pread sees both writes
+(pread-readv) end
+pread-readv: exit(0)
+EOF
+pass;
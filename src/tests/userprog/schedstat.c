@@ -0,0 +1,35 @@
+/** Checks that schedstat() counts the calling thread's waits and
+   switches, and reports the registered kernel locks. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define LOCK_CNT 32
+
+void
+test_main (void) 
+{
+  struct thread_stat before, after;
+  struct lock_stat locks[LOCK_CNT];
+  int lock_cnt, i;
+  bool found = false;
+
+  CHECK (schedstat (&before, NULL, 0) > 0, "schedstat");
+
+  /* Waiting for a child blocks us on a semaphore. */
+  wait (exec ("child-simple"));
+
+  lock_cnt = schedstat (&after, locks, LOCK_CNT);
+  CHECK (after.sema_waits > before.sema_waits, "wait counted");
+  CHECK (after.voluntary_switches > before.voluntary_switches,
+         "switch counted");
+
+  if (lock_cnt > LOCK_CNT)
+    lock_cnt = LOCK_CNT;
+  for (i = 0; i < lock_cnt; i++)
+    if (!strcmp (locks[i].name, "console"))
+      found = locks[i].acquire_cnt > 0;
+  CHECK (found, "console lock acquired");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(schedstat) begin
+(schedstat) schedstat
+(child-simple) run
+child-simple: exit(81)
+(schedstat) wait counted
+(schedstat) switch counted
+(schedstat) console lock acquired
+(schedstat) end
+schedstat: exit(0)
+EOF
+pass;
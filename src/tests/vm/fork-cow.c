@@ -0,0 +1,45 @@
+/** Forks a child, which overwrites a region of memory it shares
+   copy-on-write with its parent.  The parent must not see the
+   child's writes, nor the child the parent's later ones. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4 * 4096)
+
+static char buf[SIZE];
+
+static bool
+all_equal (const char *p, char c, size_t size)
+{
+  size_t i;
+  for (i = 0; i < size; i++)
+    if (p[i] != c)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+
+  memset (buf, 'a', SIZE);
+  child = fork ();
+  if (child == 0)
+    {
+      /* Child: sees the parent's data, then overwrites it. */
+      if (!all_equal (buf, 'a', SIZE))
+        exit (1);
+      memset (buf, 'b', SIZE);
+      exit (all_equal (buf, 'b', SIZE) ? 0x42 : 2);
+    }
+
+  CHECK (child > 0, "fork");
+  memset (buf, 'c', SIZE / 2);
+  CHECK (wait (child) == 0x42, "wait for child");
+  CHECK (all_equal (buf, 'c', SIZE / 2), "check first half");
+  CHECK (all_equal (buf + SIZE / 2, 'a', SIZE / 2), "check second half");
+}
@@ -0,0 +1,79 @@
+/** Grows and shrinks the heap with sbrk(), maps zero-filled
+   memory with mmap_anon(), then allocates, resizes and frees
+   blocks of many sizes with malloc(), checking that they don't
+   overlap and that the heap ends up where it started. */
+
+#include <malloc.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define BLOCK_CNT 300
+
+static char *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+/* Returns whether SIZE bytes at P are all C. */
+static bool
+all_equal (const char *p, char c, size_t size)
+{
+  size_t i;
+  for (i = 0; i < size; i++)
+    if (p[i] != c)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  char *start, *p;
+  mapid_t map;
+  size_t i;
+
+  /* sbrk(). */
+  start = sbrk (0);
+  CHECK (sbrk (3 * PAGE) == start, "sbrk grows the heap");
+  CHECK (all_equal (start, 0, 3 * PAGE), "new heap is zero");
+  memset (start, 'h', 3 * PAGE);
+  CHECK (sbrk (-3 * PAGE) == start + 3 * PAGE, "sbrk shrinks the heap");
+  CHECK (sbrk (-1) == (void *) -1, "can't shrink past the start");
+
+  /* mmap_anon(). */
+  p = (char *) 0x10000000;
+  map = mmap_anon (p, 5 * PAGE);
+  CHECK (map != MAP_FAILED, "mmap_anon");
+  CHECK (all_equal (p, 0, 5 * PAGE), "anonymous memory is zero");
+  memset (p, 'a', 5 * PAGE);
+  CHECK (mmap_anon (p + PAGE, PAGE) == MAP_FAILED, "no overlapping mapping");
+  munmap (map);
+
+  /* malloc(). */
+  for (i = 0; i < BLOCK_CNT; i++)
+    {
+      sizes[i] = (i * 37) % (i % 10 == 0 ? 9000 : 1100) + 1;
+      blocks[i] = malloc (sizes[i]);
+      if (blocks[i] == NULL)
+        fail ("malloc of %zu bytes failed", sizes[i]);
+      memset (blocks[i], i, sizes[i]);
+    }
+  for (i = 0; i < BLOCK_CNT; i += 2)
+    {
+      free (blocks[i]);
+      blocks[i] = NULL;
+    }
+  for (i = 1; i < BLOCK_CNT; i += 2)
+    {
+      if (!all_equal (blocks[i], i, sizes[i]))
+        fail ("block %zu was overwritten", i);
+      blocks[i] = realloc (blocks[i], sizes[i] * 3);
+      if (blocks[i] == NULL || !all_equal (blocks[i], i, sizes[i]))
+        fail ("realloc of block %zu failed", i);
+    }
+  msg ("malloc, realloc and free");
+  for (i = 0; i < BLOCK_CNT; i++)
+    free (blocks[i]);
+  CHECK (sbrk (0) == start, "heap shrinks back");
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(heap-alloc) begin
+(heap-alloc) sbrk grows the heap
+(heap-alloc) new heap is zero
+(heap-alloc) sbrk shrinks the heap
+(heap-alloc) can't shrink past the start
+(heap-alloc) mmap_anon
+(heap-alloc) anonymous memory is zero
+(heap-alloc) no overlapping mapping
+(heap-alloc) malloc, realloc and free
+(heap-alloc) heap shrinks back
+(heap-alloc) end
+EOF
+pass;
@@ -0,0 +1,73 @@
+/** Writes to a file through a mapping and checks, with pread(),
+   that msync() writes the dirty pages back while they stay
+   mapped, that munmap_range() unmaps part of the mapping after
+   writing it back, and that madvise(MADV_DONTNEED) drops a page
+   that comes back from the file on the next touch. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define SIZE (3 * PAGE + 100)
+#define ACTUAL ((char *) 0x10000000)
+
+static char buf[PAGE];
+
+/* Checks that the first SIZE bytes of page PAGE_IDX of the file
+   open as FD are all C. */
+static bool
+file_page_is (int fd, int page_idx, char c, size_t size)
+{
+  size_t i;
+
+  if (pread (fd, buf, size, page_idx * PAGE) != (int) size)
+    return false;
+  for (i = 0; i < size; i++)
+    if (buf[i] != c)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  int handle;
+  mapid_t map;
+
+  CHECK (create ("msync.dat", SIZE), "create \"msync.dat\"");
+  CHECK ((handle = open ("msync.dat")) > 1, "open \"msync.dat\"");
+  CHECK ((map = mmap (handle, ACTUAL)) != MAP_FAILED, "mmap \"msync.dat\"");
+  CHECK (madvise (ACTUAL, SIZE, MADV_SEQUENTIAL), "madvise sequential");
+  CHECK (madvise (ACTUAL, SIZE, MADV_WILLNEED), "madvise willneed");
+
+  /* Page 0: written back while still mapped. */
+  memset (ACTUAL, 'a', PAGE);
+  CHECK (msync (ACTUAL, PAGE), "msync page 0");
+  CHECK (file_page_is (handle, 0, 'a', PAGE), "page 0 written back");
+  ACTUAL[0] = 'b';
+  CHECK (file_page_is (handle, 0, 'a', PAGE), "page 0 unchanged in file");
+
+  /* Page 1: written back when unmapped; the hole stays reserved. */
+  memset (ACTUAL + PAGE, 'c', PAGE);
+  CHECK (munmap_range (ACTUAL + PAGE, PAGE), "munmap page 1");
+  CHECK (file_page_is (handle, 1, 'c', PAGE), "page 1 written back");
+  CHECK (mmap_anon (ACTUAL + PAGE, PAGE) == MAP_FAILED,
+         "can't map over page 1");
+
+  /* Page 3, the partial one: dropped, then read back in. */
+  memset (ACTUAL + 3 * PAGE, 'd', 100);
+  CHECK (madvise (ACTUAL + 3 * PAGE, 100, MADV_DONTNEED), "madvise dontneed");
+  CHECK (file_page_is (handle, 3, 'd', 100), "page 3 written back");
+  CHECK (ACTUAL[3 * PAGE] == 'd' && ACTUAL[3 * PAGE + 100] == 0,
+         "page 3 read back");
+
+  CHECK (!madvise (ACTUAL, SIZE, 42), "bad advice rejected");
+  CHECK (!msync (ACTUAL + 4 * PAGE, PAGE), "msync outside mapping rejected");
+
+  /* The rest goes with the mapping. */
+  munmap (map);
+  CHECK (file_page_is (handle, 0, 'b', 1), "page 0 written back again");
+  close (handle);
+}
@@ -0,0 +1,27 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mmap-msync) begin
+(mmap-msync) create "msync.dat"
+(mmap-msync) open "msync.dat"
+(mmap-msync) mmap "msync.dat"
+(mmap-msync) madvise sequential
+(mmap-msync) madvise willneed
+(mmap-msync) msync page 0
+(mmap-msync) page 0 written back
+(mmap-msync) page 0 unchanged in file
+(mmap-msync) munmap page 1
+(mmap-msync) page 1 written back
+(mmap-msync) can't map over page 1
+(mmap-msync) madvise dontneed
+(mmap-msync) page 3 written back
+(mmap-msync) page 3 read back
+(mmap-msync) bad advice rejected
+(mmap-msync) msync outside mapping rejected
+(mmap-msync) page 0 written back again
+(mmap-msync) end
+mmap-msync: exit(0)
+EOF
+pass;
@@ -0,0 +1,70 @@
+/** Maps a shared memory segment larger than the frames available
+   for it, and forks a child that maps it again, through the
+   inherited mapping and by key.  Each process must see the other's
+   writes, although the pages go to swap and back in between. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+#define PAGE 4096
+#define KEY 0x5348
+
+static char *const buf = (char *) 0x10000000;
+static char *const alias = (char *) 0x20000000;
+
+/* Fills page I of P with I + SEED. */
+static void
+fill (char *p, int seed)
+{
+  size_t i;
+  for (i = 0; i < SIZE / PAGE; i++)
+    memset (p + i * PAGE, i + seed, PAGE);
+}
+
+/* Returns whether P is as fill (P, SEED) left it. */
+static bool
+check (const char *p, int seed)
+{
+  size_t i;
+  for (i = 0; i < SIZE; i++)
+    if (p[i] != (char) (i / PAGE + seed))
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  mapid_t map;
+  pid_t child;
+
+  map = shm_map (KEY, SIZE, buf);
+  CHECK (map != MAP_FAILED, "shm_map");
+  fill (buf, 1);
+
+  child = fork ();
+  if (child == 0)
+    {
+      /* Child: sees the parent's data by key, and writes through
+         the mapping it inherited. */
+      if (shm_map (KEY, SIZE, alias) == MAP_FAILED)
+        exit (1);
+      if (!check (alias, 1))
+        exit (2);
+      fill (buf, 2);
+      exit (check (alias, 2) ? 0x42 : 3);
+    }
+
+  CHECK (child > 0, "fork");
+  CHECK (wait (child) == 0x42, "wait for child");
+  CHECK (check (buf, 2), "check child's writes");
+  CHECK (shm_map (KEY, SIZE + PAGE, alias) == MAP_FAILED,
+         "map more than the segment");
+
+  munmap (map);
+  CHECK (shm_map (KEY, PAGE, buf) != MAP_FAILED, "map after last unmap");
+  CHECK (buf[0] == 0 && buf[PAGE - 1] == 0, "new segment is zero");
+}
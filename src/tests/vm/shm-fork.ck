@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(shm-fork) begin
+(shm-fork) shm_map
+(shm-fork) fork
+(shm-fork) wait for child
+(shm-fork) check child's writes
+(shm-fork) map more than the segment
+(shm-fork) map after last unmap
+(shm-fork) new segment is zero
+(shm-fork) end
+EOF
+pass;
@@ -0,0 +1,22 @@
+/** Passes write() a buffer whose first and last bytes are mapped
+   but whose middle page is not.  The process must be terminated
+   with -1 exit code. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void)
+{
+  char *start = (char *) 0x10000000;
+  char *end = (char *) 0x10002000;
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (mmap (handle, start) != MAP_FAILED, "mmap \"sample.txt\" once");
+  CHECK (mmap (handle, end) != MAP_FAILED, "mmap \"sample.txt\" again");
+
+  write (handle, start, end - start + 1);
+  fail ("should have exited with -1");
+}
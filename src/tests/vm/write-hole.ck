@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(write-hole) begin
+(write-hole) open "sample.txt"
+(write-hole) mmap "sample.txt" once
+(write-hole) mmap "sample.txt" again
+write-hole: exit(-1)
+EOF
+pass;
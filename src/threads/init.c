@@ -22,6 +22,7 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -34,6 +35,7 @@
 #ifdef VM
 #include "vm/frame.h"
 #include "vm/swap.h"
+#include "vm/shm.h"
 #endif
 #ifdef FILESYS
 #include "devices/block.h"
@@ -62,8 +64,14 @@ static const char *swap_bdev_name;
 /** -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+/** -pge: Mark kernel mappings global, if the CPU supports it. */
+static bool use_global_pages;
+#define CR4_PGE       0x00000080    /**< CR4: Page Global Enable. */
+#define CPUID_EDX_PGE 0x00002000    /**< CPUID(1).EDX: PGE supported. */
+
 static void bss_init (void);
 static void paging_init (void);
+static bool cpu_has_pge (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -103,10 +111,12 @@ pintos_init (void)
   palloc_init (user_page_limit);
   malloc_init ();
   paging_init ();
+  trace_init ();
 
 #ifdef VM
   /* Initialize Virtual memory system. (Project 3) */
   vm_frame_init();
+  vm_shm_init();
 #endif
 
   /* Segmentation. */
@@ -228,6 +238,10 @@ paging_init (void)
   size_t page;
   extern char _start, _end_kernel_text;
 
+  /* Kernel mappings are the same in every page directory.  Global
+     ones stay in the TLB when CR3 is loaded on a process switch. */
+  bool global = use_global_pages && cpu_has_pge ();
+
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
   for (page = 0; page < init_ram_pages; page++)
@@ -244,7 +258,8 @@ paging_init (void)
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text)
+                    | (global ? PTE_G : 0);
     }
 
   /* Store the physical address of the page directory into CR3
@@ -253,6 +268,25 @@ paging_init (void)
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
+
+  /* Enable global pages: set CR4.PGE.  See [IA32-v3a] 3.12
+     "Translation Lookaside Buffers (TLBs)". */
+  if (global)
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PGE) : "memory");
+    }
+}
+
+/** Returns true if the CPU supports global pages, according to
+   CPUID.  See [IA32-v2a] "CPUID--CPU Identification". */
+static bool
+cpu_has_pge (void) 
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+  asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & CPUID_EDX_PGE) != 0;
 }
 
 /** Breaks the kernel command line into words and returns them as
@@ -327,6 +361,10 @@ parse_options (char **argv)
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
 #endif
+      else if (!strcmp (name, "-pge"))
+        use_global_pages = true;
+      else if (!strcmp (name, "-trace"))
+        trace_enabled = true;
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
@@ -449,6 +487,8 @@ usage (void)
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
+          "  -pge               Keep kernel mappings in the TLB on switches.\n"
+          "  -trace             Record trace events, dump them at shutdown.\n"
           );
   shutdown_power_off ();
 }
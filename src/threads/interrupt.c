@@ -206,6 +206,34 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
   register_handler (vec_no, dpl, level, handler, name);
 }
 
+/** Returns true if external interrupt VEC_NO has been raised but
+   not delivered yet, typically because interrupts are off.  Reads
+   the Interrupt Request Register of the PIC the line is on. */
+bool
+intr_ext_pending (uint8_t vec_no)
+{
+  enum intr_level old_level;
+  int irq = vec_no - 0x20;
+  uint8_t irr;
+
+  ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+
+  old_level = intr_disable ();
+  if (irq < 8)
+    {
+      outb (PIC0_CTRL, 0x0a);   /**< OCW3: read IRR. */
+      irr = inb (PIC0_CTRL);
+    }
+  else
+    {
+      outb (PIC1_CTRL, 0x0a);   /**< OCW3: read IRR. */
+      irr = inb (PIC1_CTRL);
+      irq -= 8;
+    }
+  intr_set_level (old_level);
+  return (irr & (1 << irq)) != 0;
+}
+
 /** Returns true during processing of an external interrupt
    and false at all other times. */
 bool
@@ -345,8 +373,13 @@ void
 intr_handler (struct intr_frame *frame) 
 {
   bool external;
+  bool from_user = (frame->cs & 3) == 3;
   intr_handler_func *handler;
 
+  /* Charge the time up to here to user mode. */
+  if (from_user)
+    thread_enter_kernel ();
+
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
      and they need to be acknowledged on the PIC (see below).
@@ -359,6 +392,9 @@ intr_handler (struct intr_frame *frame)
 
       in_external_intr = true;
       yield_on_return = false;
+
+      /* Catch up on ticks skipped while idle. */
+      timer_idle_exit ();
     }
 
   /* Invoke the interrupt's handler. */
@@ -386,6 +422,9 @@ intr_handler (struct intr_frame *frame)
       if (yield_on_return) 
         thread_yield (); 
     }
+
+  if (from_user)
+    thread_exit_kernel ();
 }
 
 /** Handles an unexpected interrupt with interrupt frame F.  An
@@ -27,10 +27,21 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include <schedstat.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
+
+static void refresh_waiters (struct list *waiters);
+static void sema_wake (struct semaphore *);
+static void yield_if_outranked (void);
+
+/** Locks whose contention statistics are reported, in order of
+   registration. */
+static struct list registered_locks = LIST_INITIALIZER (registered_locks);
 
 /** Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -48,6 +59,8 @@ sema_init (struct semaphore *sema, unsigned value)
 
   sema->value = value;
   list_init (&sema->waiters);
+  sema->wait_cnt = 0;
+  sema->wait_ticks = 0;
 }
 
 /** Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -66,10 +79,24 @@ sema_down (struct semaphore *sema)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  while (sema->value == 0) 
+  if (sema->value == 0)
   {
-    list_insert_ordered (&sema->waiters, &thread_current ()->elem, thread_greater_priority, NULL);
-    thread_block ();
+    struct thread *cur = thread_current ();
+    int64_t start = timer_ticks ();
+    while (sema->value == 0) 
+    {
+      /* Donations move us within the list (see
+         thread_change_priority()), so it stays ordered. */
+      list_insert_ordered (&sema->waiters, &cur->elem, thread_greater_priority, NULL);
+      cur->sema_waiting = sema;
+      thread_block ();
+      cur->sema_waiting = NULL;
+    }
+    int64_t waited = timer_ticks () - start;
+    cur->stats.sema_waits++;
+    cur->stats.sema_wait_ticks += waited;
+    sema->wait_cnt++;
+    sema->wait_ticks += waited;
   }
   sema->value--;
   intr_set_level (old_level);
@@ -113,22 +140,70 @@ sema_up (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
+  sema_wake (sema);
+  yield_if_outranked ();
+  intr_set_level (old_level);
+}
+
+/** Does the work of sema_up() but for switching threads, which is
+   up to the caller.  Interrupts must be off. */
+static void
+sema_wake (struct semaphore *sema)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
   if (!list_empty (&sema->waiters)) 
   {
-    list_sort (&sema->waiters, thread_greater_priority, NULL);
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    struct list_elem *e;
+
+    /* The waiters are kept in priority order, except that under
+       the MLFQS their priorities are only brought up to date
+       now, so the highest has to be searched for. */
+    if (thread_mlfqs)
+    {
+      refresh_waiters (&sema->waiters);
+      e = list_min (&sema->waiters, thread_greater_priority, NULL);
+    }
+    else
+      e = list_front (&sema->waiters);
+    list_remove (e);
+    thread_unblock (list_entry (e, struct thread, elem));
   }
   sema->value++;
-  if (intr_context ())
-    intr_yield_on_return ();
-  else
-    thread_yield ();
-  intr_set_level (old_level);
+}
+
+/** Only switch threads if one that was woken up (or another ready
+   thread, if we just lost a donation) now outranks us.
+   Interrupts must be off. */
+static void
+yield_if_outranked (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_outranked ())
+  {
+    if (intr_context ())
+      intr_yield_on_return ();
+    else
+      thread_yield ();
+  }
 }
 
 static void sema_test_helper (void *sema_);
 
+/** Brings the MLFQS priorities of the threads on WAITERS up to
+   date, since blocked threads are only updated lazily. */
+static void
+refresh_waiters (struct list *waiters)
+{
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (waiters); e != list_end (waiters); e = list_next (e))
+    thread_mlfqs_refresh (list_entry (e, struct thread, elem));
+}
+
 /** Self-test for semaphores that makes control "ping-pong"
    between a pair of threads.  Insert calls to printf() to see
    what's going on. */
@@ -186,6 +261,11 @@ lock_init (struct lock *lock)
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  lock->name = NULL;
+  lock->acquire_cnt = 0;
+  lock->contended_cnt = 0;
+  lock->wait_ticks = 0;
+  lock->max_hold_ticks = 0;
 }
 
 /** Acquires LOCK, sleeping until it becomes available if
@@ -207,6 +287,9 @@ lock_acquire (struct lock *lock)
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  bool contended = lock->holder != NULL;
+  int64_t start = contended ? timer_ticks () : 0;
+
   /* Lock locks, donate priority if OK. nest*/
   if (lock->holder != NULL && !thread_mlfqs)
   {
@@ -234,6 +317,13 @@ lock_acquire (struct lock *lock)
     thread_hold_the_lock (lock);
   }
   lock->holder = thread_current ();
+  lock->acquired_at = timer_ticks ();
+  lock->acquire_cnt++;
+  if (contended)
+  {
+    lock->contended_cnt++;
+    lock->wait_ticks += lock->acquired_at - start;
+  }
   intr_set_level (old_level);
 }
 
@@ -259,7 +349,19 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
+  {
+    /* lock_release() expects the lock on the holder's list. */
+    enum intr_level old_level = intr_disable ();
+    if (!thread_mlfqs)
+    {
+      lock->max_priority = thread_current ()->priority;
+      thread_hold_the_lock (lock);
+    }
     lock->holder = thread_current ();
+    lock->acquired_at = timer_ticks ();
+    lock->acquire_cnt++;
+    intr_set_level (old_level);
+  }
   return success;
 }
 
@@ -275,6 +377,9 @@ lock_release (struct lock *lock)
     thread_remove_lock(lock);
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
+  int64_t held = timer_ticks () - lock->acquired_at;
+  if (held > lock->max_hold_ticks)
+    lock->max_hold_ticks = held;
   lock->holder = NULL;
   sema_up (&lock->semaphore);   /**< Schedule in sema_up. */
 }
@@ -290,6 +395,154 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
+/** Gives LOCK a NAME and adds it to the locks whose contention
+   statistics are reported by lock_get_stats() and at shutdown.
+   Meant for long-lived global locks; LOCK must never be
+   destroyed. */
+void
+lock_register (struct lock *lock, const char *name)
+{
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+  ASSERT (name != NULL);
+  ASSERT (lock->name == NULL);
+
+  lock->name = name;
+  old_level = intr_disable ();
+  list_push_back (&registered_locks, &lock->stat_elem);
+  intr_set_level (old_level);
+}
+
+/** Stores the statistics of up to CNT registered locks into
+   STATS.  Returns the number of registered locks. */
+int
+lock_get_stats (struct lock_stat *stats, int cnt)
+{
+  enum intr_level old_level = intr_disable ();
+  struct list_elem *e;
+  int i = 0;
+
+  for (e = list_begin (&registered_locks); e != list_end (&registered_locks);
+       e = list_next (e), i++)
+    if (i < cnt)
+      {
+        struct lock *lock = list_entry (e, struct lock, stat_elem);
+        struct lock_stat *s = &stats[i];
+        strlcpy (s->name, lock->name, sizeof s->name);
+        s->acquire_cnt = lock->acquire_cnt;
+        s->contended_cnt = lock->contended_cnt;
+        s->wait_ticks = lock->wait_ticks;
+        s->max_hold_ticks = lock->max_hold_ticks;
+      }
+  intr_set_level (old_level);
+  return i;
+}
+
+/** Prints the contention statistics of the registered locks. */
+void
+lock_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&registered_locks); e != list_end (&registered_locks);
+       e = list_next (e))
+    {
+      struct lock *lock = list_entry (e, struct lock, stat_elem);
+      printf ("Lock %s: %u acquisitions, %u contended, "
+              "%"PRId64" ticks waiting, %"PRId64" ticks max hold\n",
+              lock->name, lock->acquire_cnt, lock->contended_cnt,
+              lock->wait_ticks, lock->max_hold_ticks);
+    }
+}
+
+/** Initializes RWLOCK.  Like a lock, it cannot be acquired
+   recursively, and a thread that holds it for reading must not
+   try to acquire it for writing. */
+void
+rwlock_init (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_init (&rwlock->writer);
+  rwlock->readers = 0;
+  rwlock->draining = false;
+  sema_init (&rwlock->drained, 0);
+}
+
+/** Acquires RWLOCK for reading, sleeping until no writer holds
+   it or is waiting for it. */
+void
+rwlock_read_acquire (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rwlock->writer);
+  old_level = intr_disable ();
+  rwlock->readers++;
+  intr_set_level (old_level);
+  lock_release (&rwlock->writer);
+}
+
+/** Releases RWLOCK, which the current thread holds for reading. */
+void
+rwlock_read_release (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+
+  ASSERT (rwlock != NULL);
+
+  old_level = intr_disable ();
+  ASSERT (rwlock->readers > 0);
+  if (--rwlock->readers == 0 && rwlock->draining)
+  {
+    rwlock->draining = false;
+    sema_up (&rwlock->drained);
+  }
+  intr_set_level (old_level);
+}
+
+/** Acquires RWLOCK for writing, sleeping until no one else holds
+   it.  New readers are held back as soon as we start waiting. */
+void
+rwlock_write_acquire (struct rwlock *rwlock)
+{
+  enum intr_level old_level;
+
+  ASSERT (rwlock != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rwlock->writer);
+  old_level = intr_disable ();
+  if (rwlock->readers > 0)
+  {
+    rwlock->draining = true;
+    sema_down (&rwlock->drained);
+  }
+  intr_set_level (old_level);
+}
+
+/** Releases RWLOCK, which the current thread holds for writing. */
+void
+rwlock_write_release (struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  lock_release (&rwlock->writer);
+}
+
+/** Returns true if the current thread holds RWLOCK for writing. */
+bool
+rwlock_held_for_write (const struct rwlock *rwlock)
+{
+  ASSERT (rwlock != NULL);
+
+  return lock_held_by_current_thread (&rwlock->writer) && rwlock->readers == 0;
+}
+
 /** One semaphore in a list. */
 struct semaphore_elem 
   {
@@ -360,10 +613,20 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) 
-  list_sort (&cond->waiters, cond_sema_greater_priority, NULL);
-  sema_up (&list_entry (list_pop_front (&cond->waiters),
-                       struct semaphore_elem, elem)->semaphore);
+  if (!list_empty (&cond->waiters) && thread_mlfqs)
+  {
+    struct list_elem *e;
+    enum intr_level old_level = intr_disable ();
+    for (e = list_begin (&cond->waiters); e != list_end (&cond->waiters); e = list_next (e))
+      refresh_waiters (&list_entry (e, struct semaphore_elem, elem)->semaphore.waiters);
+    intr_set_level (old_level);
+  }
+  if (!list_empty (&cond->waiters))
+  {
+    struct list_elem *e = list_min (&cond->waiters, cond_sema_greater_priority, NULL);
+    list_remove (e);
+    sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
+  }
 }
 
 /** cond sema greater function. */
@@ -388,4 +651,65 @@ cond_broadcast (struct condition *cond, struct lock *lock)
 
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
-}
\ No newline at end of file
+}
+
+/** Initializes wait queue WQ, with nobody waiting on it. */
+void
+wait_queue_init (struct wait_queue *wq)
+{
+  ASSERT (wq != NULL);
+
+  list_init (&wq->entries);
+}
+
+/** Adds ENTRY to WQ, so that SEMA is upped each time WQ is woken
+   until ENTRY is removed again with wait_queue_remove(). */
+void
+wait_queue_add (struct wait_queue *wq, struct wait_queue_entry *entry,
+                struct semaphore *sema)
+{
+  enum intr_level old_level;
+
+  ASSERT (wq != NULL);
+  ASSERT (entry != NULL);
+  ASSERT (sema != NULL);
+
+  entry->sema = sema;
+  old_level = intr_disable ();
+  list_push_back (&wq->entries, &entry->elem);
+  intr_set_level (old_level);
+}
+
+/** Removes ENTRY from the wait queue it was added to. */
+void
+wait_queue_remove (struct wait_queue_entry *entry)
+{
+  enum intr_level old_level;
+
+  ASSERT (entry != NULL);
+
+  old_level = intr_disable ();
+  list_remove (&entry->elem);
+  intr_set_level (old_level);
+}
+
+/** Ups the semaphore of every entry on WQ.  Threads are only
+   switched once all of them are up: a waiter that runs removes
+   its entries, which may then be freed under our feet.
+
+   This function may be called from an interrupt handler. */
+void
+wait_queue_wake (struct wait_queue *wq)
+{
+  enum intr_level old_level;
+  struct list_elem *e;
+
+  ASSERT (wq != NULL);
+
+  old_level = intr_disable ();
+  for (e = list_begin (&wq->entries); e != list_end (&wq->entries);
+       e = list_next (e))
+    sema_wake (list_entry (e, struct wait_queue_entry, elem)->sema);
+  yield_if_outranked ();
+  intr_set_level (old_level);
+}
@@ -3,12 +3,15 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 /** A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /**< Current value. */
     struct list waiters;        /**< List of waiting threads. */
+    unsigned wait_cnt;          /**< Number of downs that had to wait. */
+    int64_t wait_ticks;         /**< Total ticks spent waiting. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
@@ -24,6 +27,15 @@ struct lock
     struct semaphore semaphore; /**< Binary semaphore controlling access. */
     struct list_elem elem;      /**< Insert into thread's lock_list by this. */
     int max_priority;           /**< Accquiring thread max priority. */
+
+    /* Contention statistics, see lock_register(). */
+    const char *name;           /**< Name, if registered. */
+    struct list_elem stat_elem; /**< Element in the registered locks list. */
+    unsigned acquire_cnt;       /**< Number of acquisitions. */
+    unsigned contended_cnt;     /**< Acquisitions that had to wait. */
+    int64_t wait_ticks;         /**< Total ticks spent waiting. */
+    int64_t max_hold_ticks;     /**< Longest time held. */
+    int64_t acquired_at;        /**< Tick of the last acquisition. */
   };
 
 void lock_init (struct lock *);
@@ -32,6 +44,30 @@ bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
 bool lock_greater_priority (const struct list_elem *a, const struct list_elem *b, void *aux);
+void lock_register (struct lock *, const char *name);
+struct lock_stat;
+int lock_get_stats (struct lock_stat *, int cnt);
+void lock_print_stats (void);
+
+/** Readers-writer lock.  Any number of readers may hold it at
+   once, or a single writer.  A writer that is waiting keeps new
+   readers out, so writers do not starve; and since writers and
+   readers trying to get in wait on WRITER, they donate their
+   priority to the writer holding it. */
+struct rwlock
+  {
+    struct lock writer;         /**< Held by the writer, and by readers entering. */
+    int readers;                /**< Number of readers holding the lock. */
+    bool draining;              /**< A writer waits for the readers to leave. */
+    struct semaphore drained;   /**< Upped when the last reader leaves. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_read_acquire (struct rwlock *);
+void rwlock_read_release (struct rwlock *);
+void rwlock_write_acquire (struct rwlock *);
+void rwlock_write_release (struct rwlock *);
+bool rwlock_held_for_write (const struct rwlock *);
 
 /** Condition variable. */
 struct condition 
@@ -45,6 +81,33 @@ void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 bool cond_sema_greater_priority (const struct list_elem *a, const struct list_elem *b, void *aux);
 
+/** Wait queue.
+
+   Stands for some event that any number of threads may wait
+   for, as a condition variable does, except that a thread can
+   wait on several queues at once and that the event may be
+   signalled from an interrupt handler.  A waiter adds one
+   wait_queue_entry to each queue, all naming the same
+   semaphore of its own, and downs the semaphore; waking a queue
+   ups the semaphore of each entry on it. */
+struct wait_queue 
+  {
+    struct list entries;        /**< List of wait_queue_entry. */
+  };
+
+/** One thread's wait on a wait queue. */
+struct wait_queue_entry 
+  {
+    struct list_elem elem;      /**< Element in wait_queue's ENTRIES. */
+    struct semaphore *sema;     /**< Upped when the queue is woken. */
+  };
+
+void wait_queue_init (struct wait_queue *);
+void wait_queue_add (struct wait_queue *, struct wait_queue_entry *,
+                     struct semaphore *);
+void wait_queue_remove (struct wait_queue_entry *);
+void wait_queue_wake (struct wait_queue *);
+
 /** Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -10,8 +10,11 @@
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
+#include "threads/tsc.h"
 #include "threads/vaddr.h"
 #include "fixed-point.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -24,9 +27,15 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/** List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/** Run queue: processes in THREAD_READY state, that is, processes
+   that are ready to run but not actually running.  There is one
+   FIFO list per priority, and a bitmap of the non-empty lists, so
+   that adding a thread and picking the highest priority one take
+   constant time however many threads are ready. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+static struct list ready_queues[PRI_CNT];
+static uint64_t ready_bitmap;   /**< Bit P set iff ready_queues[P] is non-empty. */
+static size_t ready_cnt;        /**< Number of threads in the run queue. */
 
 /** List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -56,6 +65,19 @@ static long long user_ticks;    /**< # of timer ticks in user programs. */
 fixed_t load_avg;               /**< Load average. */
 static bool schedule_started;
 
+/** MLFQS: recent_cpu of blocked threads is decayed lazily.  Once a
+   second, only the running and ready threads are updated; a thread
+   that blocks goes on lagging_list, and when it is unblocked it
+   catches up by applying the decay factors of the seconds it
+   missed, kept in decay_history, which gives the same result as
+   updating it every second.  Threads lagging by half the history
+   are caught up by the per-second update, oldest first, so that
+   the factors they need are never overwritten. */
+#define DECAY_HISTORY 64
+static fixed_t decay_history[DECAY_HISTORY];  /**< Indexed by second % DECAY_HISTORY. */
+static int64_t mlfqs_seconds;                 /**< Seconds since boot. */
+static struct list lagging_list;              /**< Blocked threads, by recent_cpu_sec. */
+
 /** Scheduling. */
 #define TIME_SLICE 4            /**< # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /**< # of timer ticks since last yield. */
@@ -76,6 +98,13 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static int ready_max_priority (void);
+static void thread_change_priority (struct thread *, int priority);
+static int mlfqs_priority (struct thread *);
+static void mlfqs_catch_up (struct thread *);
+static void charge_cpu (struct thread *);
 
 /** Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -93,11 +122,18 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  lock_register (&tid_lock, "tid");
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&ready_queues[i]);
+  ready_bitmap = 0;
+  ready_cnt = 0;
   list_init (&all_list);
+  list_init (&lagging_list);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
@@ -135,6 +171,7 @@ thread_tick (void)
   struct thread *t = thread_current ();
 
   /* Update statistics. */
+  t->stats.run_ticks++;
   if (t == idle_thread)
     idle_ticks++;
 #ifdef USERPROG
@@ -153,8 +190,24 @@ thread_tick (void)
 void
 thread_print_stats (void) 
 {
+  struct list_elem *e;
+  enum intr_level old_level;
+
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
+
+  old_level = intr_disable ();
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      struct thread_stat *st = &t->stats;
+      printf ("Thread %s: %lld ticks run, %u voluntary and %u involuntary "
+              "switches, %u waits for %lld ticks\n",
+              t->name, st->run_ticks, st->voluntary_switches,
+              st->involuntary_switches, st->sema_waits, st->sema_wait_ticks);
+    }
+  intr_set_level (old_level);
 }
 
 /** Creates a new kernel thread named NAME with the given initial
@@ -237,7 +290,15 @@ thread_block (void)
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
-  thread_current ()->status = THREAD_BLOCKED;
+  struct thread *cur = thread_current ();
+  if (thread_mlfqs && cur != idle_thread)
+    {
+      /* up to date now; stop decaying it every second. */
+      cur->recent_cpu_sec = mlfqs_seconds;
+      cur->lagging = true;
+      list_push_back (&lagging_list, &cur->lagging_elem);
+    }
+  cur->status = THREAD_BLOCKED;
   schedule ();
 }
 
@@ -258,8 +319,10 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_insert_ordered (&ready_list, &t->elem, thread_greater_priority, NULL);
+  if (thread_mlfqs)
+    thread_mlfqs_refresh (t);
   t->status = THREAD_READY;
+  ready_push (t);
   intr_set_level (old_level);
 }
 
@@ -338,13 +401,91 @@ thread_yield (void)
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
-  if (cur != idle_thread) 
-    list_insert_ordered (&ready_list, &cur->elem, thread_greater_priority, NULL);
   cur->status = THREAD_READY;
+  if (cur != idle_thread) 
+    ready_push (cur);
   schedule ();
   intr_set_level (old_level);
 }
 
+/** Returns true if a ready thread has a higher priority than the
+   running thread, that is, if the running thread should yield. */
+bool
+thread_outranked (void)
+{
+  enum intr_level old_level = intr_disable ();
+  bool outranked = (ready_bitmap != 0
+                    && ready_max_priority () > thread_current ()->priority);
+  intr_set_level (old_level);
+  return outranked;
+}
+
+/** CPU time accounting.  Each thread's time is measured with the
+   time-stamp counter and charged to user or kernel mode: up to
+   the moment it is switched away from, and whenever it crosses
+   between user and kernel mode, the cycles since its cpu_stamp
+   are added to the counter for the mode it was in.  Interrupts
+   that arrive in user mode, including system calls, call
+   thread_enter_kernel() on entry and thread_exit_kernel() on
+   return. */
+
+/** Charges the cycles T has run since its cpu_stamp to its
+   current mode.  Interrupts must be off. */
+static void
+charge_cpu (struct thread *t)
+{
+  uint64_t now = tsc_read ();
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->in_user)
+    t->user_cycles += now - t->cpu_stamp;
+  else
+    t->kernel_cycles += now - t->cpu_stamp;
+  t->cpu_stamp = now;
+}
+
+/** Records that the running thread has entered the kernel from
+   user mode. */
+void
+thread_enter_kernel (void)
+{
+  enum intr_level old_level = intr_disable ();
+  struct thread *t = thread_current ();
+
+  charge_cpu (t);
+  t->in_user = false;
+  intr_set_level (old_level);
+}
+
+/** Records that the running thread is about to return to user
+   mode. */
+void
+thread_exit_kernel (void)
+{
+  enum intr_level old_level = intr_disable ();
+  struct thread *t = thread_current ();
+
+  charge_cpu (t);
+  t->in_user = true;
+  intr_set_level (old_level);
+}
+
+/** Stores the number of time-stamp counter cycles the running
+   thread has run in user mode into *USER and in kernel mode
+   into *KERNEL. */
+void
+thread_cpu_cycles (uint64_t *user, uint64_t *kernel)
+{
+  enum intr_level old_level = intr_disable ();
+  struct thread *t = thread_current ();
+
+  charge_cpu (t);
+  *user = t->user_cycles;
+  *kernel = t->kernel_cycles;
+  intr_set_level (old_level);
+}
+
 /** Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void
@@ -421,13 +562,6 @@ thread_get_recent_cpu (void)
 }
 
 
-/** Less fuc for thread. */
-bool 
-thread_less_ticks_blocked (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
-{
-  return list_entry (a, struct thread, elem)->ticks_blocked < list_entry (b, struct thread, elem)->ticks_blocked;
-}
-
 /** Greater fuc for thread. */
 bool 
 thread_greater_priority (const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
@@ -439,14 +573,8 @@ thread_greater_priority (const struct list_elem *a, const struct list_elem *b, v
 void
 thread_donate_priority (struct thread *t)
 {
-  enum intr_level old_level = intr_disable ();
+  /* thread_update_priority() moves T to its new run queue. */
   thread_update_priority (t);
-  if (t->status == THREAD_READY)
-  {
-    list_remove (&t->elem);
-    list_insert_ordered (&ready_list, &t->elem, thread_greater_priority, NULL);
-  }
-  intr_set_level (old_level);
 }
 
 /** Update priority. */
@@ -465,7 +593,7 @@ thread_update_priority (struct thread *t)
       max_priority = lock_priority;
   }
 
-  t->priority = max_priority;
+  thread_change_priority (t, max_priority);
   intr_set_level (old_level);
 }
 
@@ -508,31 +636,95 @@ thread_mlfqs_increase_recent_cpu_by_one (void)
   current_thread->recent_cpu = FP_ADD_MIX (current_thread->recent_cpu, 1);
 }
 
-/* Every per second to refresh load_avg and recent_cpu of all threads. */
+/* Every per second to refresh load_avg, and recent_cpu of the
+   threads that are running or ready.  Blocked threads are caught up
+   later (see lagging_list). */
 void
 thread_mlfqs_update_load_avg_and_recent_cpu (void)
 {
   ASSERT (thread_mlfqs);
   ASSERT (intr_context ());
 
-  size_t ready_threads = list_size (&ready_list);
+  size_t ready_threads = ready_cnt;
   if (thread_current () != idle_thread)
     ready_threads++;
   load_avg = FP_ADD (FP_DIV_MIX (FP_MULT_MIX (load_avg, 59), 60), FP_DIV_MIX (FP_CONST (ready_threads), 60));
 
-  struct thread *t;
-  struct list_elem *e = list_begin (&all_list);
-  for (; e != list_end (&all_list); e = list_next (e))
+  /* This second's decay factor is the same for every thread. */
+  fixed_t decay = FP_DIV (FP_MULT_MIX (load_avg, 2), FP_ADD_MIX (FP_MULT_MIX (load_avg, 2), 1));
+  mlfqs_seconds++;
+  decay_history[mlfqs_seconds % DECAY_HISTORY] = decay;
+
+  struct thread *t = thread_current ();
+  if (t != idle_thread)
   {
-    t = list_entry(e, struct thread, allelem);
+    t->recent_cpu = FP_ADD_MIX (FP_MULT (decay, t->recent_cpu), t->nice);
+    thread_mlfqs_update_priority (t);
+  }
+
+  /* Rebuild the run queue with the new priorities, taking threads
+     from the highest priority down, so the order among threads
+     that stay at the same level is kept. */
+  struct list ready;
+  int p;
+  list_init (&ready);
+  for (p = PRI_MAX; p >= PRI_MIN; p--)
+    while (!list_empty (&ready_queues[p]))
+      list_push_back (&ready, list_pop_front (&ready_queues[p]));
+  ready_bitmap = 0;
+  ready_cnt = 0;
+  while (!list_empty (&ready))
+  {
+    t = list_entry (list_pop_front (&ready), struct thread, elem);
     if (t != idle_thread)
     {
-      t->recent_cpu = FP_ADD_MIX (FP_MULT (FP_DIV (FP_MULT_MIX (load_avg, 2), FP_ADD_MIX (FP_MULT_MIX (load_avg, 2), 1)), t->recent_cpu), t->nice);
-      thread_mlfqs_update_priority (t);
+      t->recent_cpu = FP_ADD_MIX (FP_MULT (decay, t->recent_cpu), t->nice);
+      t->priority = mlfqs_priority (t);
     }
+    ready_push (t);
+  }
+
+  /* Catch up the threads which have been blocked for so long that
+     the decay factors they need would soon be overwritten. */
+  while (!list_empty (&lagging_list))
+  {
+    t = list_entry (list_front (&lagging_list), struct thread, lagging_elem);
+    if (t->recent_cpu_sec > mlfqs_seconds - DECAY_HISTORY / 2)
+      break;
+    thread_mlfqs_refresh (t);
+    t->lagging = true;
+    list_push_back (&lagging_list, &t->lagging_elem);
   }
 }
 
+/** Applies to T, which is blocked, the decay of recent_cpu it has
+   missed since it blocked, and updates its priority accordingly.
+   Interrupts must be off. */
+void
+thread_mlfqs_refresh (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!t->lagging)
+    return;
+  list_remove (&t->lagging_elem);
+  t->lagging = false;
+  mlfqs_catch_up (t);
+  t->priority = mlfqs_priority (t);
+}
+
+/** Brings the recent_cpu of T, last updated at second
+   T->recent_cpu_sec, up to date. */
+static void
+mlfqs_catch_up (struct thread *t)
+{
+  ASSERT (mlfqs_seconds - t->recent_cpu_sec < DECAY_HISTORY);
+
+  for (; t->recent_cpu_sec < mlfqs_seconds; t->recent_cpu_sec++)
+    t->recent_cpu = FP_ADD_MIX (FP_MULT (decay_history[(t->recent_cpu_sec + 1) % DECAY_HISTORY],
+                                         t->recent_cpu), t->nice);
+}
+
 /* Update priority. */
 void
 thread_mlfqs_update_priority (struct thread *t)
@@ -543,9 +735,43 @@ thread_mlfqs_update_priority (struct thread *t)
   ASSERT (thread_mlfqs);
   ASSERT (t != idle_thread);
 
-  t->priority = FP_INT_PART (FP_SUB_MIX (FP_SUB (FP_CONST (PRI_MAX), FP_DIV_MIX (t->recent_cpu, 4)), 2 * t->nice));
-  t->priority = t->priority < PRI_MIN ? PRI_MIN : t->priority;
-  t->priority = t->priority > PRI_MAX ? PRI_MAX : t->priority;
+  thread_change_priority (t, mlfqs_priority (t));
+}
+
+/* The priority T should have, from its recent_cpu and nice. */
+static int
+mlfqs_priority (struct thread *t)
+{
+  int priority = FP_INT_PART (FP_SUB_MIX (FP_SUB (FP_CONST (PRI_MAX), FP_DIV_MIX (t->recent_cpu, 4)), 2 * t->nice));
+  priority = priority < PRI_MIN ? PRI_MIN : priority;
+  priority = priority > PRI_MAX ? PRI_MAX : priority;
+  return priority;
+}
+
+/** Sets the (effective) priority of T to PRIORITY, moving T to the
+   matching run queue if it is ready.  Interrupts must be off. */
+static void
+thread_change_priority (struct thread *t, int priority)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->status == THREAD_READY && t != idle_thread)
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
+  else if (t->status == THREAD_BLOCKED && t->sema_waiting != NULL
+           && t->priority != priority)
+    {
+      /* Keep the semaphore's waiters ordered by priority. */
+      list_remove (&t->elem);
+      t->priority = priority;
+      list_insert_ordered (&t->sema_waiting->waiters, &t->elem,
+                           thread_greater_priority, NULL);
+    }
+  else
+    t->priority = priority;
 }
 
 /** Idle thread.  Executes when no other thread is ready to run.
@@ -570,6 +796,10 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Nothing to run until an interrupt arrives: stop the
+         periodic tick if no timer is due soon. */
+      timer_idle ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -630,12 +860,12 @@ init_thread (struct thread *t, const char *name, int priority)
   ASSERT (name != NULL);
 
   memset (t, 0, sizeof *t);
+  t->cpu_stamp = tsc_read ();
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
     t->priority = priority;
   t->magic = THREAD_MAGIC;
-  t->ticks_blocked = 0;
   t->base_priority = priority;
   list_init (&t->locks_holding);
   t->lock_waiting = NULL;
@@ -644,21 +874,24 @@ init_thread (struct thread *t, const char *name, int priority)
     t->recent_cpu = FP_CONST (0);
   else
     t->recent_cpu = thread_current ()->recent_cpu;
+  t->recent_cpu_sec = mlfqs_seconds;
+  t->lagging = false;
 #ifdef FILESYS
     t->dir = NULL;
 #endif
   old_level = intr_disable ();
-  list_insert_ordered (&all_list, &t->allelem, thread_greater_priority, NULL);
+  list_push_back (&all_list, &t->allelem);
   intr_set_level (old_level);
 
 #ifdef USERPROG
   list_init(&t->child_list);
   t->pcb = NULL;
-  list_init(&t->file_descriptors);
+  fd_table_init(&t->fds);
   t->executing_file = NULL;
 #endif
 #ifdef VM
   list_init(&t->mmap_list);
+  t->heap_start = t->brk = NULL;
 #endif
 }
 
@@ -683,10 +916,48 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  if (ready_bitmap == 0)
     return idle_thread;
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    {
+      struct thread *t = list_entry (list_front (&ready_queues[ready_max_priority ()]),
+                                     struct thread, elem);
+      ready_remove (t);
+      return t;
+    }
+}
+
+/** Appends T, which is ready, to the run queue of its priority.
+   Interrupts must be off. */
+static void
+ready_push (struct thread *t)
+{
+  list_push_back (&ready_queues[t->priority], &t->elem);
+  ready_bitmap |= (uint64_t) 1 << t->priority;
+  ready_cnt++;
+}
+
+/** Removes T from the run queue of its priority.
+   Interrupts must be off. */
+static void
+ready_remove (struct thread *t)
+{
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[t->priority]))
+    ready_bitmap &= ~((uint64_t) 1 << t->priority);
+  ready_cnt--;
+}
+
+/** Returns the highest priority with a ready thread.  The run
+   queue must not be empty. */
+static int
+ready_max_priority (void)
+{
+  uint32_t high = ready_bitmap >> 32, low = ready_bitmap;
+
+  ASSERT (ready_bitmap != 0);
+  /* (__builtin_clzll would need libgcc on a 32-bit target.) */
+  return high != 0 ? 63 - __builtin_clz (high) : 31 - __builtin_clz (low);
 }
 
 /** Completes a thread switch by activating the new thread's page
@@ -712,8 +983,9 @@ thread_schedule_tail (struct thread *prev)
   
   ASSERT (intr_get_level () == INTR_OFF);
 
-  /* Mark us as running. */
+  /* Mark us as running, and start charging CPU time to us. */
   cur->status = THREAD_RUNNING;
+  cur->cpu_stamp = tsc_read ();
 
   /* Start new time slice. */
   thread_ticks = 0;
@@ -754,7 +1026,16 @@ schedule (void)
   ASSERT (is_thread (next));
 
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      /* A thread that is still ready was preempted, or yielded. */
+      if (cur->status == THREAD_READY)
+        cur->stats.involuntary_switches++;
+      else
+        cur->stats.voluntary_switches++;
+      charge_cpu (cur);
+      trace (TRACE_SWITCH, cur->status, next->tid);
+      prev = switch_threads (cur, next);
+    }
   thread_schedule_tail (prev);
 }
 
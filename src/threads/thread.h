@@ -3,9 +3,13 @@
 
 #include <debug.h>
 #include <list.h>
+#include <schedstat.h>
 #include <stdint.h>
 #include "fixed-point.h"
 
+#ifdef USERPROG
+#include "userprog/fdtable.h"
+#endif
 #ifdef VM
 #include "vm/page.h"
 #endif
@@ -94,12 +98,21 @@ struct thread
     uint8_t *stack;                     /**< Saved stack pointer. */
     int priority;                       /**< Priority. */
     struct list_elem allelem;           /**< List element for all threads list. */
-    int64_t ticks_blocked;              /**< Blocked ticks. */
     int base_priority;                  /**< Base priotiry. */
     struct list locks_holding;          /**< Holding locks. */
     struct lock *lock_waiting;          /**< Waiting lock */
+    struct semaphore *sema_waiting;     /**< Semaphore blocked on, if any. */
+    struct thread_stat stats;           /**< Scheduling statistics. */
+    uint64_t user_cycles;               /**< Time-stamp counter cycles run in user mode. */
+    uint64_t kernel_cycles;             /**< Cycles run in kernel mode. */
+    uint64_t cpu_stamp;                 /**< Counter when the cycles were last charged. */
+    bool in_user;                       /**< Running in user mode? */
     int nice;                           /* Niceness. */
     fixed_t recent_cpu;                 /* Recent CPU. */
+    int64_t recent_cpu_sec;             /**< MLFQS second recent_cpu is up to date
+                                             with, while blocked (see thread.c). */
+    struct list_elem lagging_elem;      /**< Element of the lagging threads list. */
+    bool lagging;                       /**< On the lagging threads list? */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /**< List element. */
@@ -110,8 +123,10 @@ struct thread
     struct process_control_block *pcb;  /**<  Process Control Block */
     struct list child_list;             /**<  List of children processes of this thread,
                                           each elem is defined by pcb#elem */
-    struct list file_descriptors;       /**<  List of file_descriptors the thread contains */
+    struct fd_table fds;                /**<  Open files, by file descriptor */
     struct file *executing_file;        /**<  The executable file of associated process. */
+    uint64_t child_user_cycles;         /**< User cycles of the children waited for. */
+    uint64_t child_kernel_cycles;       /**< Kernel cycles of the children waited for. */
     uint8_t *current_esp;               /**< The current value of the user program’s stack pointer.
                                              A  page fault might occur in the kernel, so we might
                                              need to store esp on transition to kernel mode. (4.3.3) */
@@ -123,6 +138,9 @@ struct thread
 
    /* Project 3: Memory Mapped Files. */
    struct list mmap_list;                  /**< List of struct mmap_desc. */
+
+   uint8_t *heap_start;                    /**< Start of the heap, a VM_REGION_HEAP. */
+   uint8_t *brk;                           /**< End of the heap, moved by sbrk(). */
 #endif
 #ifdef FILESYS
    struct dir *dir;                       /** Current directory. */
@@ -156,6 +174,11 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+bool thread_outranked (void);
+
+void thread_enter_kernel (void);
+void thread_exit_kernel (void);
+void thread_cpu_cycles (uint64_t *user, uint64_t *kernel);
 
 /** Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func (struct thread *t, void *aux);
@@ -171,6 +194,7 @@ int thread_get_load_avg (void);
 void thread_mlfqs_increase_recent_cpu_by_one (void);
 void thread_mlfqs_update_load_avg_and_recent_cpu (void);
 void thread_mlfqs_update_priority (struct thread *t);
+void thread_mlfqs_refresh (struct thread *t);
 
 /** Auxiliary functions. */
 bool thread_greater_priority (const struct list_elem *a, const struct list_elem *b, void *aux);
@@ -178,6 +202,5 @@ void thread_donate_priority (struct thread *t);
 void thread_hold_the_lock (struct lock* lock);
 void thread_remove_lock (struct lock *lock);
 void thread_update_priority (struct thread *t);
-bool thread_less_ticks_blocked (const struct list_elem *a, const struct list_elem *b, void *aux);
 
 #endif /**< threads/thread.h */
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/** Size of the ring buffer.  The number of events must be a power
+   of 2 so that the ring index can be masked. */
+#define TRACE_PAGES 16
+#define TRACE_EVENT_CNT (TRACE_PAGES * PGSIZE / sizeof (struct trace_event))
+
+/** True if events are being recorded.  Set by the -trace kernel
+   option, before trace_init() is called. */
+bool trace_enabled;
+
+/** The ring buffer. */
+static struct trace_event *events;
+
+/** Total number of events recorded; the next one goes into
+   events[head % TRACE_EVENT_CNT]. */
+static uint32_t head;
+
+/** Allocates the ring buffer, if tracing is enabled. */
+void
+trace_init (void)
+{
+  ASSERT ((TRACE_EVENT_CNT & (TRACE_EVENT_CNT - 1)) == 0);
+
+  if (!trace_enabled)
+    return;
+  trace_enabled = false;
+  events = palloc_get_multiple (PAL_ZERO, TRACE_PAGES);
+  if (events == NULL)
+    {
+      printf ("trace: out of memory, tracing disabled\n");
+      return;
+    }
+  trace_enabled = true;
+}
+
+/** Records an event.  A slot is claimed with a single atomic
+   increment, so an interrupt handler that records an event in
+   the middle of this one just gets the next slot. */
+void
+trace_record (enum trace_type type, uint8_t flags, uint32_t arg)
+{
+  uint32_t slot = __sync_fetch_and_add (&head, 1) % TRACE_EVENT_CNT;
+  struct trace_event *e = &events[slot];
+
+  e->tsc = tsc_read ();
+  e->type = type;
+  e->flags = flags;
+  e->tid = thread_current ()->tid;
+  e->arg = arg;
+}
+
+/** Prints the recorded events, oldest first, one per line in hex,
+   between a header and a footer line that utils/pintos-trace
+   looks for.  The header gives the time-stamp counter frequency,
+   as measured by the timer. */
+void
+trace_dump (void)
+{
+  uint32_t cnt, i;
+
+  if (!trace_enabled)
+    return;
+  trace_enabled = false;
+
+  cnt = head < TRACE_EVENT_CNT ? head : TRACE_EVENT_CNT;
+  printf ("Trace: %"PRIu32" events, %"PRIu32" dropped, %"PRIu64" Hz\n",
+          cnt, head - cnt, timer_tsc_freq ());
+  for (i = head - cnt; i != head; i++)
+    {
+      const uint8_t *p = (const uint8_t *) &events[i % TRACE_EVENT_CNT];
+      size_t j;
+
+      printf ("T ");
+      for (j = 0; j < sizeof (struct trace_event); j++)
+        printf ("%02x", p[j]);
+      printf ("\n");
+    }
+  printf ("Trace end\n");
+}
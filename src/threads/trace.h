@@ -0,0 +1,56 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Kernel event tracing.
+
+   When tracing is enabled with the -trace kernel option, the
+   kernel records fixed-size binary events, each stamped with the
+   time-stamp counter, into a ring buffer that keeps the most
+   recent TRACE_EVENT_CNT of them.  Recording an event takes no
+   lock and does no I/O.  The buffer is dumped over the console
+   at shutdown; utils/pintos-trace decodes the dump. */
+
+/** Event types.  utils/pintos-trace knows these by number. */
+enum trace_type
+  {
+    TRACE_SWITCH = 1,           /**< Context switch; ARG is the next tid. */
+    TRACE_PAGE_FAULT,           /**< Page fault; ARG is the fault address. */
+    TRACE_CACHE_MISS,           /**< Buffer cache miss; ARG is the sector. */
+    TRACE_DISK_START,           /**< Sector I/O started; ARG is the sector. */
+    TRACE_DISK_FINISH,          /**< Sector I/O finished; ARG is the sector. */
+    TRACE_SYSCALL_ENTER,        /**< System call; ARG is its number. */
+    TRACE_SYSCALL_EXIT          /**< System call return; ARG is the result. */
+  };
+
+/** A trace event, 16 bytes. */
+struct trace_event
+  {
+    uint64_t tsc;               /**< Time-stamp counter. */
+    uint8_t type;               /**< A trace_type. */
+    uint8_t flags;              /**< Type-specific flags. */
+    int16_t tid;                /**< Thread that recorded it. */
+    uint32_t arg;               /**< Type-specific argument. */
+  };
+
+/** Flags of TRACE_DISK_* events. */
+#define TRACE_DISK_WRITE 0x1    /**< A write, not a read. */
+
+extern bool trace_enabled;
+
+void trace_init (void);
+void trace_record (enum trace_type, uint8_t flags, uint32_t arg);
+void trace_dump (void);
+
+/** Records an event of the given TYPE, FLAGS and ARG, if tracing
+   is enabled.  May be called from any context. */
+static inline void
+trace (enum trace_type type, uint8_t flags, uint32_t arg)
+{
+  if (trace_enabled)
+    trace_record (type, flags, arg);
+}
+
+#endif /**< threads/trace.h */
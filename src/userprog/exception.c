@@ -3,17 +3,17 @@
 #include <stdio.h>
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
+#include "userprog/uaccess.h"
 #include "userprog/pagedir.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
 #ifdef VM
 #include "vm/page.h"
 #include "vm/frame.h"
 #endif
 
-#define MAX_STACK_SIZE 0x800000
-
 /** Number of page faults processed. */
 static long long page_fault_cnt;
 
@@ -151,6 +151,7 @@ page_fault (struct intr_frame *f)
 
   /* Count page faults. */
   page_fault_cnt++;
+  trace (TRACE_PAGE_FAULT, f->error_code, (uint32_t) fault_addr);
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
@@ -171,7 +172,15 @@ page_fault (struct intr_frame *f)
   void* fault_page = (void*) pg_round_down(fault_addr);
 
   if (!not_present) {
-    /* attempt to write to a read-only region is always killed. */
+    /* a write to a page shared copy-on-write after fork()
+      gets a private copy; any other attempt to write to
+      a read-only region is always killed. */
+    bool broken;
+    lock_acquire (&curr->supt->lock);
+    broken = write && vm_supt_break_cow (curr->supt, curr->pagedir, fault_page);
+    lock_release (&curr->supt->lock);
+    if (broken)
+      return;
     goto PAGE_FAULT_VIOLATED_ACCESS;
   }
 
@@ -187,7 +196,9 @@ page_fault (struct intr_frame *f)
                     fault_addr == f->esp - 4 || /**< PUSH */
                     fault_addr == f->esp - 32); /**< PUSHA */
   is_stack_addr = (PHYS_BASE - MAX_STACK_SIZE <= fault_addr && fault_addr < PHYS_BASE);
-  if (on_stack_frame && is_stack_addr) 
+  lock_acquire (&curr->supt->lock);
+  if (on_stack_frame && is_stack_addr
+      && vm_supt_grow_stack (curr->supt, fault_page)) 
   {
     /* OK. Do not die, and grow.
       we need to add new page entry in the SUPT, if there was no page entry in the SUPT.
@@ -196,7 +207,9 @@ page_fault (struct intr_frame *f)
       vm_supt_install_zeropage (curr->supt, fault_page);
   }
 
-  if(! vm_load_page(curr->supt, curr->pagedir, fault_page) ) 
+  bool loaded = vm_load_page(curr->supt, curr->pagedir, fault_page);
+  lock_release (&curr->supt->lock);
+  if(! loaded) 
     goto PAGE_FAULT_VIOLATED_ACCESS;
 
   /* success */
@@ -204,13 +217,10 @@ page_fault (struct intr_frame *f)
 
 PAGE_FAULT_VIOLATED_ACCESS:
 #endif
-  /* (3.1.5) a page fault in the kernel merely sets eax to 0xffffffff
-    and copies its former value into eip */
-   if(!user) {
-      f->eip = (void *) f->eax;
-      f->eax = 0xffffffff;
+  /* A page fault in the kernel while copying to or from user memory
+    ends the copy early; see userprog/usercopy.S. */
+   if(!user && uaccess_fixup (f))
       return;
-   }
 
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
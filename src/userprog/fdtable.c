@@ -0,0 +1,155 @@
+#include "userprog/fdtable.h"
+#include <debug.h>
+#include <stddef.h>
+#include "threads/malloc.h"
+#include "filesys/directory.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "userprog/pipe.h"
+#include "userprog/process.h"
+
+/** Initial number of elements in a table's array. */
+#define FD_TABLE_MIN_SIZE 16
+
+static bool grow (struct fd_table *, int min_size);
+
+/** Initializes T as an empty table.  The array is not allocated
+   until the first descriptor is installed. */
+void
+fd_table_init (struct fd_table *t)
+{
+  t->descs = NULL;
+  t->size = 0;
+  t->lowest_free = FD_FIRST;
+}
+
+/** Frees T's array.  T must be empty: the caller is responsible
+   for removing and freeing each descriptor first. */
+void
+fd_table_destroy (struct fd_table *t)
+{
+  free (t->descs);
+  fd_table_init (t);
+}
+
+/** Installs DESC in T under the lowest unused descriptor, which
+   is returned, or returns -1 if memory is exhausted or all of
+   the descriptors below FD_MAX are in use. */
+int
+fd_table_install (struct fd_table *t, struct file_desc *desc)
+{
+  int fd;
+
+  for (fd = t->lowest_free; fd < t->size; fd++)
+    if (t->descs[fd] == NULL)
+      break;
+  if (fd >= FD_MAX || !fd_table_install_at (t, fd, desc))
+    return -1;
+  return fd;
+}
+
+/** Installs DESC in T under descriptor FD, which must be unused
+   and below FD_MAX.  Returns false if memory is exhausted. */
+bool
+fd_table_install_at (struct fd_table *t, int fd, struct file_desc *desc)
+{
+  ASSERT (fd >= 0 && fd < FD_MAX);
+  ASSERT (desc != NULL);
+  ASSERT (fd_table_lookup (t, fd) == NULL);
+
+  if (fd >= t->size && !grow (t, fd + 1))
+    return false;
+  t->descs[fd] = desc;
+  if (fd == t->lowest_free)
+    for (t->lowest_free++; t->lowest_free < t->size; t->lowest_free++)
+      if (t->descs[t->lowest_free] == NULL)
+        break;
+  return true;
+}
+
+/** Returns the file_desc for FD in T, or a null pointer if FD is
+   not open. */
+struct file_desc *
+fd_table_lookup (const struct fd_table *t, int fd)
+{
+  if (fd < 0 || fd >= t->size)
+    return NULL;
+  return t->descs[fd];
+}
+
+/** Removes FD from T and returns its file_desc, which the caller
+   must free, or returns a null pointer if FD is not open. */
+struct file_desc *
+fd_table_remove (struct fd_table *t, int fd)
+{
+  struct file_desc *desc = fd_table_lookup (t, fd);
+
+  if (desc != NULL)
+    {
+      t->descs[fd] = NULL;
+      if (fd >= FD_FIRST && fd < t->lowest_free)
+        t->lowest_free = fd;
+    }
+  return desc;
+}
+
+/** Returns a new descriptor for what DESC refers to: the same
+   pipe end, or the same open file or directory, whose position
+   the two share from now on, as after dup() in POSIX.  Returns a
+   null pointer if memory is exhausted. */
+struct file_desc *
+file_desc_dup (const struct file_desc *desc)
+{
+  struct file_desc *copy = malloc (sizeof *copy);
+  if (copy == NULL)
+    return NULL;
+
+  *copy = *desc;
+  if (desc->pipe != NULL)
+    pipe_open (desc->pipe, desc->pipe_writer);
+  else if (inode_is_dir (file_get_inode (desc->file)))
+    copy->file = dir_dup (desc->file);
+  else
+    copy->file = file_dup (desc->file);
+  return copy;
+}
+
+/** Closes the file, directory or pipe end DESC refers to, and
+   frees DESC. */
+void
+file_desc_close (struct file_desc *desc)
+{
+  if (desc->pipe != NULL)
+    pipe_close (desc->pipe, desc->pipe_writer);
+  else if (inode_is_dir (file_get_inode (desc->file)))
+    dir_close (desc->file);
+  else
+    file_close (desc->file);
+  free (desc);
+}
+
+/** Grows T's array to at least MIN_SIZE elements, doubling its
+   size so that installing N descriptors takes O(N) time
+   overall, but never past FD_MAX elements.  Returns false if
+   memory is exhausted or MIN_SIZE is more than FD_MAX. */
+static bool
+grow (struct fd_table *t, int min_size)
+{
+  struct file_desc **descs;
+  int size, i;
+
+  if (min_size > FD_MAX)
+    return false;
+  size = t->size > 0 ? t->size : FD_TABLE_MIN_SIZE;
+  while (size < min_size)
+    size = size <= FD_MAX / 2 ? size * 2 : FD_MAX;
+
+  descs = realloc (t->descs, size * sizeof *descs);
+  if (descs == NULL)
+    return false;
+  for (i = t->size; i < size; i++)
+    descs[i] = NULL;
+  t->descs = descs;
+  t->size = size;
+  return true;
+}
@@ -0,0 +1,41 @@
+#ifndef USERPROG_FDTABLE_H
+#define USERPROG_FDTABLE_H
+
+#include <stdbool.h>
+
+/** A process's file descriptor table.
+
+   Maps file descriptors to the struct file_desc that describes
+   the open file, through an array indexed by descriptor, so that
+   looking up a descriptor takes constant time.  The array grows
+   as needed.  Like POSIX, a new descriptor is the lowest one not
+   in use. */
+struct fd_table
+  {
+    struct file_desc **descs;   /**< Indexed by descriptor, NULL if unused. */
+    int size;                   /**< Number of elements in DESCS. */
+    int lowest_free;            /**< No unused descriptor is below this. */
+  };
+
+/** Descriptors 0, 1 and 2 are stdin, stdout and stderr, which
+   are the console unless dup2() has put something in the table
+   under them.  New descriptors start above them. */
+#define FD_FIRST 3
+
+/** Descriptors are below this, so that a process can't make the
+   kernel allocate a table of any size it likes (see dup2()). */
+#define FD_MAX 1024
+
+struct file_desc;
+
+void fd_table_init (struct fd_table *);
+void fd_table_destroy (struct fd_table *);
+int fd_table_install (struct fd_table *, struct file_desc *);
+bool fd_table_install_at (struct fd_table *, int fd, struct file_desc *);
+struct file_desc *fd_table_lookup (const struct fd_table *, int fd);
+struct file_desc *fd_table_remove (struct fd_table *, int fd);
+
+struct file_desc *file_desc_dup (const struct file_desc *);
+void file_desc_close (struct file_desc *);
+
+#endif /**< userprog/fdtable.h */
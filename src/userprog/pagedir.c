@@ -6,8 +6,13 @@
 #include "threads/pte.h"
 #include "threads/palloc.h"
 
+/** Above this many pages, invalidating a range of pages one by
+   one costs more than flushing the whole TLB. */
+#define INVLPG_MAX 32
+
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
 
 /** Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -152,8 +157,41 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_page (pd, upage);
+    }
+}
+
+/** Marks the user pages in [START, END) "not present" in page
+   directory PD, as pagedir_clear_page() would do one by one, but
+   invalidates the TLB only once for the whole range: page by page
+   if few were mapped, with a full flush otherwise. */
+void
+pagedir_clear_range (uint32_t *pd, void *start, void *end) 
+{
+  const void *cleared[INVLPG_MAX];
+  size_t cnt = 0, i;
+  uint8_t *upage;
+
+  ASSERT (pg_ofs (start) == 0);
+  ASSERT (end <= PHYS_BASE);
+
+  for (upage = start; upage < (uint8_t *) end; upage += PGSIZE)
+    {
+      uint32_t *pte = lookup_page (pd, upage, false);
+      if (pte != NULL && (*pte & PTE_P) != 0)
+        {
+          *pte &= ~PTE_P;
+          if (cnt < INVLPG_MAX)
+            cleared[cnt] = upage;
+          cnt++;
+        }
     }
+
+  if (cnt > INVLPG_MAX)
+    invalidate_pagedir (pd);
+  else
+    for (i = 0; i < cnt; i++)
+      invalidate_page (pd, cleared[i]);
 }
 
 /** Returns true if the PTE for virtual page VPAGE in PD is dirty,
@@ -180,7 +218,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -209,11 +247,64 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
 
+/** Sets the writable bit to WRITABLE in the PTE for user virtual
+   page UPAGE in PD.  Used to write-protect pages shared
+   copy-on-write by fork(), and to lift the protection once the
+   page is no longer shared. */
+void
+pagedir_set_writable (uint32_t *pd, const void *upage, bool writable) 
+{
+  uint32_t *pte = lookup_page (pd, upage, false);
+  if (pte != NULL) 
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else 
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_page (pd, upage);
+    }
+}
+
+/** Maps a private copy of every user page present in SRC at the
+   same address in DST, preserving writability.  This is fork()
+   without virtual memory, where nothing can be shared.
+   Returns false if memory allocation fails. */
+bool
+pagedir_copy_user (uint32_t *dst, uint32_t *src) 
+{
+  uint32_t *pde;
+
+  ASSERT (dst != init_page_dir && src != init_page_dir);
+  for (pde = src; pde < src + pd_no (PHYS_BASE); pde++)
+    if (*pde & PTE_P) 
+      {
+        uint32_t *pt = pde_get_pt (*pde);
+        uint32_t *pte;
+
+        for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
+          if (*pte & PTE_P) 
+            {
+              void *upage = (void *) (((uintptr_t) (pde - src) << PDSHIFT)
+                                      | ((uintptr_t) (pte - pt) << PTSHIFT));
+              void *kpage = palloc_get_page (PAL_USER);
+              if (kpage == NULL)
+                return false;
+              memcpy (kpage, pte_get_page (*pte), PGSIZE);
+              if (!pagedir_set_page (dst, upage, kpage, (*pte & PTE_W) != 0))
+                {
+                  palloc_free_page (kpage);
+                  return false;
+                }
+            }
+      }
+  return true;
+}
+
 /** Loads page directory PD into the CPU's page directory base
    register. */
 void
@@ -261,3 +352,14 @@ invalidate_pagedir (uint32_t *pd)
       pagedir_activate (pd);
     } 
 }
+
+/** Invalidates the TLB entry for the page at VADDR, if PD is the
+   active page directory.  This is enough after changing a single
+   PTE, and keeps the rest of the TLB.  See [IA32-v2a] "INVLPG--
+   Invalidate TLB Entry". */
+static void
+invalidate_page (uint32_t *pd, const void *vaddr) 
+{
+  if (active_pd () == pd)
+    asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+}
@@ -0,0 +1,222 @@
+#include "userprog/pipe.h"
+#include <debug.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/** Bytes of data a pipe holds.  A power of two, so that the
+   free-running HEAD and TAIL counters below wrap around cleanly. */
+#define PIPE_SIZE PGSIZE
+
+/** A pipe.
+
+   HEAD counts the bytes ever written and TAIL the bytes ever
+   read, so HEAD - TAIL bytes are waiting in BUFFER.  Only the
+   writer holding WRITE_LOCK changes HEAD, and only the reader
+   holding READ_LOCK changes TAIL, so a reader and a writer move
+   data without taking any lock in common: each copies its bytes
+   first, and only then publishes them by advancing its counter. */
+struct pipe
+  {
+    uint8_t *buffer;            /**< PIPE_SIZE bytes of ring buffer. */
+    uint32_t head;              /**< Bytes written so far. */
+    uint32_t tail;              /**< Bytes read so far. */
+    struct lock read_lock;      /**< Makes readers take turns. */
+    struct lock write_lock;     /**< Makes writers take turns. */
+    struct semaphore readable;  /**< Upped when data or end of file comes. */
+    struct semaphore writable;  /**< Upped when room frees or readers go. */
+    struct wait_queue pollers;  /**< Woken on any of the above. */
+    int readers;                /**< Number of open read ends. */
+    int writers;                /**< Number of open write ends. */
+  };
+
+/** Creates a new, empty pipe, with one read end and one write end
+   open.  Returns a null pointer if memory is exhausted. */
+struct pipe *
+pipe_create (void)
+{
+  struct pipe *p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->buffer = palloc_get_page (0);
+  if (p->buffer == NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  p->head = p->tail = 0;
+  lock_init (&p->read_lock);
+  lock_init (&p->write_lock);
+  sema_init (&p->readable, 0);
+  sema_init (&p->writable, 0);
+  wait_queue_init (&p->pollers);
+  p->readers = p->writers = 1;
+  return p;
+}
+
+/** Opens one more read end of P, or write end if WRITER. */
+void
+pipe_open (struct pipe *p, bool writer)
+{
+  enum intr_level old_level = intr_disable ();
+  if (writer)
+    p->writers++;
+  else
+    p->readers++;
+  intr_set_level (old_level);
+}
+
+/** Closes a read end of P, or a write end if WRITER.  Closing the
+   last write end lets readers see end of file; closing the last
+   read end makes writes fail.  P is freed when no end is open. */
+void
+pipe_close (struct pipe *p, bool writer)
+{
+  enum intr_level old_level = intr_disable ();
+  bool last;
+  if (writer)
+    {
+      ASSERT (p->writers > 0);
+      if (--p->writers == 0)
+        sema_up (&p->readable);
+    }
+  else
+    {
+      ASSERT (p->readers > 0);
+      if (--p->readers == 0)
+        sema_up (&p->writable);
+    }
+  last = p->readers == 0 && p->writers == 0;
+  if (!last)
+    wait_queue_wake (&p->pollers);
+  intr_set_level (old_level);
+
+  if (last)
+    {
+      palloc_free_page (p->buffer);
+      free (p);
+    }
+}
+
+/** Reads up to SIZE bytes from P into BUFFER, waiting until at
+   least one byte is there.  Returns the number of bytes read, or
+   0 at end of file, when no write end is open and P is empty. */
+int
+pipe_read (struct pipe *p, void *buffer_, unsigned size)
+{
+  uint8_t *buffer = buffer_;
+  uint32_t n, ofs, first;
+
+  if (size == 0)
+    return 0;
+
+  lock_acquire (&p->read_lock);
+  for (;;)
+    {
+      /* Look at WRITERS before HEAD: once the last writer is gone,
+         HEAD has stopped moving. */
+      int writers = p->writers;
+      barrier ();
+      if (p->head != p->tail)
+        break;
+      if (writers == 0)
+        {
+          lock_release (&p->read_lock);
+          return 0;
+        }
+      sema_down (&p->readable);
+    }
+
+  n = p->head - p->tail;
+  if (n > size)
+    n = size;
+  ofs = p->tail % PIPE_SIZE;
+  first = n < PIPE_SIZE - ofs ? n : PIPE_SIZE - ofs;
+  memcpy (buffer, p->buffer + ofs, first);
+  memcpy (buffer + first, p->buffer, n - first);
+  barrier ();
+  p->tail += n;
+  sema_up (&p->writable);
+  wait_queue_wake (&p->pollers);
+  lock_release (&p->read_lock);
+
+  return n;
+}
+
+/** Writes SIZE bytes from BUFFER into P, waiting for room as
+   necessary.  Returns the number of bytes written, which is less
+   than SIZE only if no read end is left open, or -1 if none was
+   open to begin with.  Writes by different writers do not
+   interleave. */
+int
+pipe_write (struct pipe *p, const void *buffer_, unsigned size)
+{
+  const uint8_t *buffer = buffer_;
+  unsigned done = 0;
+
+  lock_acquire (&p->write_lock);
+  while (done < size && p->readers > 0)
+    {
+      uint32_t room = PIPE_SIZE - (p->head - p->tail);
+      uint32_t n, ofs, first;
+      if (room == 0)
+        {
+          sema_down (&p->writable);
+          continue;
+        }
+
+      n = size - done < room ? size - done : room;
+      ofs = p->head % PIPE_SIZE;
+      first = n < PIPE_SIZE - ofs ? n : PIPE_SIZE - ofs;
+      memcpy (p->buffer + ofs, buffer + done, first);
+      memcpy (p->buffer, buffer + done + first, n - first);
+      barrier ();
+      p->head += n;
+      done += n;
+      sema_up (&p->readable);
+      wait_queue_wake (&p->pollers);
+    }
+  lock_release (&p->write_lock);
+
+  return done > 0 || size == 0 ? (int) done : -1;
+}
+
+/** Returns the poll() events that apply to the read end of P, or
+   to its write end if WRITER: POLLIN or POLLHUP for a read end,
+   POLLOUT or POLLERR for a write end. */
+int
+pipe_poll (struct pipe *p, bool writer)
+{
+  int events = 0;
+
+  if (writer)
+    {
+      if (p->readers == 0)
+        events |= POLLERR;
+      else if (p->head - p->tail < PIPE_SIZE)
+        events |= POLLOUT;
+    }
+  else
+    {
+      /* Look at WRITERS before HEAD, as pipe_read() does. */
+      if (p->writers == 0)
+        events |= POLLHUP;
+      barrier ();
+      if (p->head != p->tail)
+        events |= POLLIN;
+    }
+  return events;
+}
+
+/** Returns the wait queue that is woken whenever data, room, or
+   the open ends of P change. */
+struct wait_queue *
+pipe_wait_queue (struct pipe *p)
+{
+  return &p->pollers;
+}
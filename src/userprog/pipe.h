@@ -0,0 +1,19 @@
+#ifndef USERPROG_PIPE_H
+#define USERPROG_PIPE_H
+
+#include <stdbool.h>
+
+/** An anonymous pipe: a page-sized ring buffer with a read end
+   and a write end, each of which may be open in any number of
+   descriptors. */
+struct pipe;
+
+struct pipe *pipe_create (void);
+void pipe_open (struct pipe *, bool writer);
+void pipe_close (struct pipe *, bool writer);
+int pipe_read (struct pipe *, void *, unsigned size);
+int pipe_write (struct pipe *, const void *, unsigned size);
+int pipe_poll (struct pipe *, bool writer);
+struct wait_queue *pipe_wait_queue (struct pipe *);
+
+#endif /**< userprog/pipe.h */
@@ -21,6 +21,7 @@
 #include "threads/vaddr.h"
 #include "vm/frame.h"
 #include "vm/page.h"
+#include "vm/shm.h"
 
 #ifndef VM
 /* alternative of vm-related functions introduced in Project 3. */
@@ -35,8 +36,10 @@
 #endif
 
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
 static void push_arguments (const char *[], int argc, void **esp);
+static bool inherit_fds (struct thread *parent, bool exec);
 
 /** Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
@@ -76,6 +79,7 @@ process_execute(const char *file_name)
   /* Initial PCB. */
   pcb->pid = PID_INITIALIZING;
   pcb->cmdline = cmd_all;
+  pcb->parent_thread = thread_current();
   pcb->waiting = false;
   pcb->exited = false;
   pcb->orphan = false;
@@ -83,6 +87,7 @@ process_execute(const char *file_name)
 
   sema_init(&pcb->sema_initialization, 0);
   sema_init(&pcb->sema_wait, 0);
+  wait_queue_init(&pcb->exit_waiters);
 
   /* Create a new thread to execute PROC_CMD. */
   tid = thread_create(proc_name, PRI_DEFAULT, start_process, pcb);
@@ -147,6 +152,12 @@ start_process(void *pcb_)
   if_.eflags = FLAG_IF | FLAG_MBS;
   success = load(file_name, &if_.eip, &if_.esp);
 
+  /* The new process starts with copies of its parent's file
+     descriptors, redirected stdin and stdout included.  The parent
+     sleeps in process_execute() until we are done with them. */
+  if (success)
+    success = inherit_fds(pcb->parent_thread, true);
+
   /* If load succeeds, push arguments to the stack. */
   if (success) {
     push_arguments(cmdline_tokens, cnt, &if_.esp);
@@ -173,10 +184,240 @@ start_process(void *pcb_)
 #endif
 
   /* Start the user process by simulating a return from an interrupt. */
+  thread_exit_kernel ();
   asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
   NOT_REACHED();
 }
 
+/** What the parent hands over to start_fork(); lives on the
+   parent's stack, which is fine since the parent sleeps until the
+   child has copied everything out of it. */
+struct fork_args 
+  {
+    struct thread *parent;                  /**< The process being duplicated. */
+    struct intr_frame if_;                  /**< Its user context at fork(). */
+    struct process_control_block *pcb;      /**< The PCB of the child. */
+  };
+
+/** Duplicates the current process: the child resumes from the
+   system call with user context IF_, returning 0, with a copy of
+   the address space (copy-on-write under VM) and of every open
+   file descriptor.  Returns the pid of the child, or PID_ERROR. */
+pid_t 
+process_fork (const struct intr_frame *if_) 
+{
+  struct fork_args args;
+  struct process_control_block *pcb;
+  tid_t tid;
+
+  pcb = palloc_get_page (0);
+  if (pcb == NULL)
+    return PID_ERROR;
+
+  /* Initial PCB, see process_execute(). */
+  pcb->pid = PID_INITIALIZING;
+  pcb->cmdline = NULL;
+  pcb->parent_thread = thread_current ();
+  pcb->waiting = false;
+  pcb->exited = false;
+  pcb->orphan = false;
+  pcb->exitcode = -1; /**< undefined */
+
+  sema_init (&pcb->sema_initialization, 0);
+  sema_init (&pcb->sema_wait, 0);
+  wait_queue_init (&pcb->exit_waiters);
+
+  args.parent = thread_current ();
+  args.if_ = *if_;
+  args.pcb = pcb;
+
+  tid = thread_create (thread_name (), PRI_DEFAULT, start_fork, &args);
+  if (tid == TID_ERROR) 
+    {
+      palloc_free_page (pcb);
+      return PID_ERROR;
+    }
+
+  /* Wait until the child is done copying from us. */
+  sema_down (&pcb->sema_initialization);
+
+  if (pcb->pid >= 0)
+    list_push_back (&thread_current ()->child_list, &pcb->elem);
+
+  return pcb->pid;
+}
+
+#ifdef VM
+/** vm_supt_fork() callback: maps a file of the parent (AUX) backing
+   some of its pages to the child's own copy of it. */
+static struct file *
+fork_translate_file (struct file *file, void *aux) 
+{
+  struct fork_args *args = aux;
+  struct thread *cur = thread_current ();
+  struct list_elem *pe, *ce;
+
+  if (file == args->parent->executing_file)
+    return cur->executing_file;
+
+  /* the mmap lists are copied in order. */
+  for (pe = list_begin (&args->parent->mmap_list),
+       ce = list_begin (&cur->mmap_list);
+       pe != list_end (&args->parent->mmap_list);
+       pe = list_next (pe), ce = list_next (ce))
+    if (list_entry (pe, struct mmap_desc, elem)->file == file)
+      return list_entry (ce, struct mmap_desc, elem)->file;
+
+  PANIC ("fork: a page is backed by a file the process doesn't own");
+}
+#endif
+
+/** Copies the file descriptors of PARENT into the current process,
+   keeping descriptor numbers; the open files, directories and pipe
+   ends are shared, positions included.  For EXEC, those marked close-on-exec are left out.
+   Returns false if out of memory. */
+static bool
+inherit_fds (struct thread *parent, bool exec) 
+{
+  struct thread *cur = thread_current ();
+  int fd;
+
+  for (fd = 0; fd < parent->fds.size; fd++) 
+    {
+      struct file_desc *pd = fd_table_lookup (&parent->fds, fd);
+      struct file_desc *cd;
+      if (pd == NULL || (exec && pd->cloexec))
+        continue;
+
+      cd = file_desc_dup (pd);
+      if (cd == NULL)
+        return false;
+      if (!fd_table_install_at (&cur->fds, fd, cd))
+        {
+          file_desc_close (cd);
+          return false;
+        }
+    }
+  return true;
+}
+
+/** Copies the open files and mappings of PARENT into the current
+   process, sharing the open files behind the descriptors.  Returns
+   false if out of memory. */
+static bool
+fork_files (struct thread *parent) 
+{
+  struct thread *cur = thread_current ();
+
+  if (parent->executing_file != NULL) 
+    {
+      cur->executing_file = file_reopen (parent->executing_file);
+      if (cur->executing_file == NULL)
+        return false;
+      file_deny_write (cur->executing_file);
+    }
+
+  if (!inherit_fds (parent, false))
+    return false;
+
+#ifdef VM
+  struct list_elem *e;
+  for (e = list_begin (&parent->mmap_list);
+       e != list_end (&parent->mmap_list); e = list_next (e)) 
+    {
+      struct mmap_desc *pm = list_entry (e, struct mmap_desc, elem);
+      struct mmap_desc *cm = malloc (sizeof *cm);
+      if (cm == NULL)
+        return false;
+
+      *cm = *pm;
+      if (pm->shm != NULL)
+        vm_shm_reopen (pm->shm);
+      else if (pm->file != NULL)
+        {
+          cm->file = file_reopen (pm->file);
+          if (cm->file == NULL) 
+            {
+              free (cm);
+              return false;
+            }
+        }
+      list_push_back (&cur->mmap_list, &cm->elem);
+    }
+#endif
+  return true;
+}
+
+/** A thread function that turns a new thread into a copy of the
+   process that called fork(), and returns to user mode in it. */
+static void
+start_fork (void *args_) 
+{
+  struct fork_args *args = args_;
+  struct thread *t = thread_current ();
+  struct thread *parent = args->parent;
+  struct process_control_block *pcb = args->pcb;
+  bool success = false;
+
+  /* fork() returns 0 in the child. */
+  struct intr_frame if_ = args->if_;
+  if_.eax = 0;
+
+  t->pagedir = pagedir_create ();
+#ifdef VM
+  t->supt = vm_supt_create ();
+#endif
+  if (t->pagedir == NULL)
+    goto done;
+  process_activate ();
+
+  if (!fork_files (parent))
+    goto done;
+
+#ifdef VM
+  /* the parent is waiting for us, and doesn't hold its own lock. */
+  lock_acquire (&t->supt->lock);
+  lock_acquire (&parent->supt->lock);
+  success = vm_supt_fork (t->supt, t->pagedir, t, parent->supt, parent->pagedir,
+                          fork_translate_file, args);
+  lock_release (&parent->supt->lock);
+  lock_release (&t->supt->lock);
+  t->heap_start = parent->heap_start;
+  t->brk = parent->brk;
+#else
+  success = pagedir_copy_user (t->pagedir, parent->pagedir);
+#endif
+
+done:
+  /* Assign PCB, and wake up sleeping process_fork(). */
+  pcb->pid = success ? (pid_t) (t->tid) : PID_ERROR;
+  t->pcb = pcb;
+  sema_up (&pcb->sema_initialization);
+
+  if (!success) 
+    {
+#ifdef VM
+      /* the pages of the mappings may not all have made it into the
+        SUPT; don't let process_exit() unmap them. */
+      while (!list_empty (&t->mmap_list)) 
+        {
+          struct mmap_desc *desc = list_entry (list_pop_front (&t->mmap_list),
+                                               struct mmap_desc, elem);
+          if (desc->shm != NULL)
+            vm_shm_close (desc->shm);
+          file_close (desc->file);
+          free (desc);
+        }
+#endif
+      sys_exit (-1);
+    }
+
+  /* Start the user process by simulating a return from an interrupt. */
+  thread_exit_kernel ();
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
 /** Waits for thread TID to die and returns its exit status.  If
    it was terminated by the kernel (i.e. killed due to an
    exception), returns -1.  If TID is invalid or if it was not a
@@ -190,25 +431,9 @@ int
 process_wait (tid_t child_tid UNUSED) 
 {
   struct thread *t = thread_current ();
-  struct list *child_list = &(t->child_list);
 
   /* lookup the process with tid equals 'child_tid' from 'child_list'. */
-  struct process_control_block *child_pcb = NULL;
-  struct list_elem *it = NULL;
-  if (!list_empty(child_list)) 
-    {
-      for (it = list_front(child_list); it != list_end(child_list); it = list_next(it)) 
-        {
-          struct process_control_block *pcb = list_entry (
-              it, struct process_control_block, elem);
-
-          if(pcb->pid == child_tid) 
-            { /* OK, the direct child found. */
-              child_pcb = pcb;
-              break;
-            }
-        }
-    }
+  struct process_control_block *child_pcb = process_find_child (child_tid);
 
   /* if child process is not found, return -1 immediately. */
   if (child_pcb == NULL) 
@@ -237,11 +462,12 @@ process_wait (tid_t child_tid UNUSED)
   ASSERT (child_pcb->exited == true);
 
   /* remove from child_list. */
-  ASSERT (it != NULL);
-  list_remove (it);
+  list_remove (&child_pcb->elem);
 
-  /* return the exit code of the child process. */
+  /* return the exit code of the child process, and account for its CPU time. */
   int retcode = child_pcb->exitcode;
+  t->child_user_cycles += child_pcb->user_cycles;
+  t->child_kernel_cycles += child_pcb->kernel_cycles;
 
   /* Now the pcb object of the child process can be finally freed. 
     (in this context, the child process is guaranteed to have been exited). */
@@ -250,6 +476,25 @@ process_wait (tid_t child_tid UNUSED)
   return retcode;
 }
 
+/** Returns the PCB of the current process's child PID, or a null
+   pointer if it has no such child, or has already waited for it. */
+struct process_control_block *
+process_find_child (pid_t pid) 
+{
+  struct list *child_list = &thread_current ()->child_list;
+  struct list_elem *it;
+
+  for (it = list_begin (child_list); it != list_end (child_list);
+       it = list_next (it)) 
+    {
+      struct process_control_block *pcb = list_entry (
+          it, struct process_control_block, elem);
+      if (pcb->pid == pid)
+        return pcb;
+    }
+  return NULL;
+}
+
 /** Free the current process's resources. */
 void
 process_exit (void)
@@ -259,22 +504,14 @@ process_exit (void)
 
   /* Resources should be cleaned up */
   /* 1. file descriptors */
-  struct list *fdlist = &cur->file_descriptors;
-  while (!list_empty(fdlist)) 
+  int fd;
+  for (fd = 0; fd < cur->fds.size; fd++) 
     {
-      struct list_elem *e = list_pop_front (fdlist);
-      struct file_desc *desc = list_entry(e, struct file_desc, elem);
-      struct inode* inode = file_get_inode(desc->file);
-
-      if(inode == NULL)
-        continue;
-
-      if(inode_is_dir(inode))
-        dir_close(desc->file);
-      else
-        file_close (desc->file);
-      palloc_free_page(desc); /**< see sys_open(). */
+      struct file_desc *desc = fd_table_remove (&cur->fds, fd);
+      if (desc != NULL)
+        file_desc_close (desc);
     }
+  fd_table_destroy (&cur->fds);
 #ifdef VM
   /* mmap descriptors */
   struct list *mmlist = &cur->mmap_list;
@@ -324,7 +561,14 @@ process_exit (void)
   /* We should get orphan status here, because it can be freed by its 
     parent after sema_up. So cur->pcb->orphan could be erro. */
   bool cur_pcb_orphan = cur->pcb->orphan;
+  thread_cpu_cycles (&cur->pcb->user_cycles, &cur->pcb->kernel_cycles);
+  cur->pcb->user_cycles += cur->child_user_cycles;
+  cur->pcb->kernel_cycles += cur->child_kernel_cycles;
   cur->pcb->exited = true;
+
+  /* Wake poll() first: the parent may free the pcb as soon as
+     wait() returns. */
+  wait_queue_wake (&cur->pcb->exit_waiters);
   sema_up (&cur->pcb->sema_wait);
 
   /* Destroy the pcb object by itself, if it is orphan.
@@ -459,6 +703,9 @@ load (const char *file_name, void (**eip) (void), void **esp)
   off_t file_ofs;
   bool success = false;
   int i;
+#ifdef VM
+  uint8_t *heap_start = NULL;
+#endif
 
   /* Allocate and activate page directory. */
   t->pagedir = pagedir_create ();
@@ -542,6 +789,10 @@ load (const char *file_name, void (**eip) (void), void **esp)
               if (!load_segment (file, file_page, (void *) mem_page,
                                  read_bytes, zero_bytes, writable))
                 goto done;
+#ifdef VM
+              if ((uint8_t *) mem_page + read_bytes + zero_bytes > heap_start)
+                heap_start = (uint8_t *) mem_page + read_bytes + zero_bytes;
+#endif
             }
           else
             goto done;
@@ -553,6 +804,15 @@ load (const char *file_name, void (**eip) (void), void **esp)
   if (!setup_stack (esp))
     goto done;
 
+#ifdef VM
+  /* The heap starts out empty, right after the highest segment. */
+  if (heap_start == NULL
+      || !vm_supt_install_region (t->supt, heap_start, NULL, 0, 0, 0, true,
+                                  VM_REGION_HEAP))
+    goto done;
+  t->heap_start = t->brk = heap_start;
+#endif
+
   /* Start address. */
   *eip = (void (*) (void)) ehdr.e_entry;
 
@@ -640,6 +900,13 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
+#ifdef VM
+  /* Lazy load: the whole segment is described by a single region.
+     Nothing is read nor zeroed until one of its pages is touched. */
+  return vm_supt_install_region (thread_current ()->supt, upage, file, ofs,
+                                 read_bytes, zero_bytes, writable,
+                                 VM_REGION_SEGMENT);
+#else
   file_seek (file, ofs);
   while (read_bytes > 0 || zero_bytes > 0) 
     {
@@ -649,16 +916,6 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-#ifdef VM
-      /* Lazy load */
-      struct thread *curr = thread_current ();
-      ASSERT (pagedir_get_page(curr->pagedir, upage) == NULL); /**< no virtual page yet? */
-
-      if (! vm_supt_install_filesys(curr->supt, upage,
-            file, ofs, page_read_bytes, page_zero_bytes, writable) ) {
-        return false;
-      }
-#else
       /* Get a page of memory. */
       uint8_t *kpage = vm_frame_allocate (PAL_USER, upage);
       if (kpage == NULL)
@@ -678,17 +935,14 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
-#endif
 
       /* Advance. */
       read_bytes -= page_read_bytes;
       zero_bytes -= page_zero_bytes;
       upage += PGSIZE;
-#ifdef VM
-      ofs += PGSIZE;
-#endif
     }
   return true;
+#endif
 }
 
 /** Create a minimal stack by mapping a zeroed page at the top of
@@ -708,6 +962,13 @@ setup_stack (void **esp)
       else
         vm_frame_free (kpage);
     }
+#ifdef VM
+  /* The stack region, grown as the stack is (vm_supt_grow_stack). */
+  success = success
+    && vm_supt_install_region (thread_current ()->supt,
+                               PHYS_BASE - PGSIZE, NULL, 0,
+                               0, PGSIZE, true, VM_REGION_STACK);
+#endif
   return success;
 }
 
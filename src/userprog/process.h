@@ -10,7 +10,10 @@ typedef int pid_t;
 #define PID_INITIALIZING  ((pid_t) -2)
 
 pid_t process_execute (const char *file_name);
+struct intr_frame;
+pid_t process_fork (const struct intr_frame *);
 int process_wait (tid_t);
+struct process_control_block *process_find_child (pid_t);
 void process_exit (void);
 void process_activate (void);
 
@@ -26,19 +29,24 @@ struct process_control_block
     bool exited;                            /**< indicates whether the process is done (exited). */
     bool orphan;                            /**< indicates whether the parent process has terminated before. */
     int32_t exitcode;                       /**< the exit code passed from exit(), when exited = true */
+    uint64_t user_cycles;                   /**< user mode CPU cycles of the process and the children
+                                                 it waited for, when exited = true */
+    uint64_t kernel_cycles;                 /**< kernel mode CPU cycles, likewise */
 
     /* Synchronization */
     struct semaphore sema_initialization;   /**< the semaphore used between start_process() and process_execute() */
     struct semaphore sema_wait;             /**< the semaphore used for wait() : parent blocks until child exits */
+    struct wait_queue exit_waiters;         /**< woken when the process exits, for poll() */
 };
 
 /** File description. */
 struct file_desc 
 {
-    int id;                                 /**< Identify file. */
-    struct list_elem elem;                  /**< element for thread.file_descriptors */
-    void* file;                             /**< file object. */
+    void* file;                             /**< file object, or NULL for a pipe. */
     bool is_dir;                            /**< true if it is a directory. */
+    struct pipe* pipe;                      /**< pipe, or NULL for a file. */
+    bool pipe_writer;                       /**< true for the write end of PIPE. */
+    bool cloexec;                           /**< not inherited by exec(). */
 };
 
 #ifdef VM
@@ -48,6 +56,7 @@ struct mmap_desc {
   mmapid_t id;
   struct list_elem elem;
   struct file* file;
+  struct vm_shm *shm;  /**< shared memory mapped instead of FILE, or NULL. */
 
   void *addr;   /**< where it is mapped to? store the user virtual address. */
   size_t size;  /**< file size */
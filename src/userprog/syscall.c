@@ -2,11 +2,23 @@
 #include "devices/input.h"
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <round.h>
+#include <string.h>
 #include <syscall-nr.h>
+#include <rusage.h>
+#include <uio.h>
+#include <poll.h>
+#include <schedstat.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #include "userprog/process.h"
+#include "userprog/pagedir.h"
+#include "userprog/pipe.h"
+#include "userprog/tss.h"
+#include "userprog/uaccess.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
 #include "threads/palloc.h"
@@ -15,6 +27,7 @@
 #include "lib/kernel/list.h"
 #ifdef VM
 #include "vm/page.h"
+#include "vm/shm.h"
 #endif
 #ifdef FILESYS
 #include "filesys/inode.h"
@@ -30,12 +43,15 @@
 static void syscall_handler (struct intr_frame *);
 
 /** Auxiliary Functions.*/
-static void check_user (const uint8_t *uaddr);
-static int32_t get_user (const uint8_t *uaddr);
-static bool put_user (uint8_t *udst, uint8_t byte);
+static void check_user_range (const void *uaddr, size_t bytes);
 static int memread_user (void *src, void *des, size_t bytes);
+static int memwrite_user (void *dst, const void *src, size_t bytes);
+static char *copy_in_string (const char *ustr);
+static int copy_in_iovec (struct iovec *, const struct iovec *uiov, int iovcnt);
 static struct file_desc* find_file_desc(struct thread *, int fd);
-static bool validate_user_string(const char *uaddr);
+static short poll_events(const struct pollfd *);
+static struct wait_queue *poll_wait_queue(const struct pollfd *);
+static void poll_timeout(struct timer *, void *sema);
 static int fail_invalid_access(void);
 bool sys_chdir(char *path, struct intr_frame *f);
 bool sys_mkdir(char *path, struct intr_frame *f);
@@ -46,11 +62,25 @@ int sys_inumber(int fd, struct intr_frame *f);
 #ifdef VM
 mmapid_t sys_mmap(int fd, void *);
 bool sys_munmap(mmapid_t);
+mmapid_t sys_shm_map(int key, size_t size, void *);
+mmapid_t sys_mmap_anon(void *, size_t size);
+void *sys_sbrk(intptr_t increment);
+bool sys_msync(void *, size_t length);
+bool sys_madvise(void *, size_t length, int advice);
+bool sys_munmap_range(void *, size_t length);
 
 static struct mmap_desc* find_mmap_desc(struct thread *, mmapid_t fd);
-
-void preload_and_pin_pages(const void *, size_t);
+static struct mmap_desc* find_mmap_desc_at(struct thread *, void *start, void *end);
+static mmapid_t add_mmap_desc(struct file *, struct vm_shm *, void *addr, size_t size);
+static void free_mmap_desc(struct thread *, struct mmap_desc *);
+static void unmap_pages(struct thread *, struct mmap_desc *, void *start, void *end);
+static bool user_range(void *addr, size_t length, void **end);
+static bool mmap_range_is_free(struct thread *, void *start, void *end);
+
+bool preload_and_pin_pages(const void *, size_t, bool write);
 void unpin_preloaded_pages(const void *, size_t);
+static bool preload_and_pin_iovec(const struct iovec *, int iovcnt, bool write);
+static void unpin_preloaded_iovec(const struct iovec *, int iovcnt);
 #endif
 
 
@@ -58,6 +88,19 @@ void
 syscall_init (void) 
 {
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+  tss_enable_sysenter (sysenter_entry);
+}
+
+/** Handles a system call made with SYSENTER.  Called by
+   sysenter_entry in sysenter.S with interrupts off and F laid
+   out as for "int $0x30"; does what intr_handler() would. */
+void
+syscall_handler_sysenter (struct intr_frame *f)
+{
+  thread_enter_kernel ();
+  intr_enable ();
+  syscall_handler (f);
+  thread_exit_kernel ();
 }
 
 static void
@@ -70,6 +113,7 @@ syscall_handler (struct intr_frame *f UNUSED)
   memread_user(f->esp, &syscall_number, sizeof(syscall_number));
 
   _DEBUG_PRINTF ("[DEBUG] system call, number = %d!\n", syscall_number);
+  trace (TRACE_SYSCALL_ENTER, 0, syscall_number);
 
   /* Store the esp, which is needed in the page fault handler.
    refer to exception.c:page_fault() (see manual 4.3.3) */
@@ -103,6 +147,31 @@ syscall_handler (struct intr_frame *f UNUSED)
           f->eax = (uint32_t) return_code;
           break;
         }
+      case SYS_FORK:
+        {
+          f->eax = (uint32_t) sys_fork(f);
+          break;
+        }
+      case SYS_SCHEDSTAT:
+        {
+          struct thread_stat *self;
+          struct lock_stat *locks;
+          int lock_cnt;
+          memread_user(f->esp + 4, &self, sizeof(self));
+          memread_user(f->esp + 8, &locks, sizeof(locks));
+          memread_user(f->esp + 12, &lock_cnt, sizeof(lock_cnt));
+          f->eax = (uint32_t) sys_schedstat(self, locks, lock_cnt);
+          break;
+        }
+      case SYS_GETRUSAGE:
+        {
+          int who;
+          struct rusage *usage;
+          memread_user(f->esp + 4, &who, sizeof(who));
+          memread_user(f->esp + 8, &usage, sizeof(usage));
+          f->eax = (uint32_t) sys_getrusage(who, usage);
+          break;
+        }
       case SYS_WAIT:
         {
           pid_t pid;
@@ -172,6 +241,79 @@ syscall_handler (struct intr_frame *f UNUSED)
         f->eax = (uint32_t) return_code;
         break;
       }
+      case SYS_PREAD:
+      case SYS_PWRITE:
+        {
+          int fd;
+          void *buffer;
+          unsigned size, offset;
+          memread_user(f->esp + 4, &fd, sizeof(fd));
+          memread_user(f->esp + 8, &buffer, sizeof(buffer));
+          memread_user(f->esp + 12, &size, sizeof(size));
+          memread_user(f->esp + 16, &offset, sizeof(offset));
+          if (syscall_number == SYS_PREAD)
+            f->eax = (uint32_t) sys_pread(fd, buffer, size, offset);
+          else
+            f->eax = (uint32_t) sys_pwrite(fd, buffer, size, offset);
+          break;
+        }
+      case SYS_READV:
+      case SYS_WRITEV:
+        {
+          int fd, iovcnt;
+          const struct iovec *iov;
+          memread_user(f->esp + 4, &fd, sizeof(fd));
+          memread_user(f->esp + 8, &iov, sizeof(iov));
+          memread_user(f->esp + 12, &iovcnt, sizeof(iovcnt));
+          if (syscall_number == SYS_READV)
+            f->eax = (uint32_t) sys_readv(fd, iov, iovcnt);
+          else
+            f->eax = (uint32_t) sys_writev(fd, iov, iovcnt);
+          break;
+        }
+      case SYS_COPY_FILE_RANGE:
+        {
+          int fd_in, fd_out;
+          unsigned size;
+          memread_user(f->esp + 4, &fd_in, sizeof(fd_in));
+          memread_user(f->esp + 8, &fd_out, sizeof(fd_out));
+          memread_user(f->esp + 12, &size, sizeof(size));
+          f->eax = (uint32_t) sys_copy_file_range(fd_in, fd_out, size);
+          break;
+        }
+      case SYS_PIPE:
+        {
+          int *fds;
+          memread_user(f->esp + 4, &fds, sizeof(fds));
+          f->eax = (uint32_t) sys_pipe(fds);
+          break;
+        }
+      case SYS_DUP2:
+        {
+          int old_fd, new_fd;
+          memread_user(f->esp + 4, &old_fd, sizeof(old_fd));
+          memread_user(f->esp + 8, &new_fd, sizeof(new_fd));
+          f->eax = (uint32_t) sys_dup2(old_fd, new_fd);
+          break;
+        }
+      case SYS_SET_CLOEXEC:
+        {
+          int fd, cloexec;
+          memread_user(f->esp + 4, &fd, sizeof(fd));
+          memread_user(f->esp + 8, &cloexec, sizeof(cloexec));
+          f->eax = (uint32_t) sys_set_cloexec(fd, cloexec != 0);
+          break;
+        }
+      case SYS_POLL:
+        {
+          struct pollfd *fds;
+          int nfds, timeout;
+          memread_user(f->esp + 4, &fds, sizeof(fds));
+          memread_user(f->esp + 8, &nfds, sizeof(nfds));
+          memread_user(f->esp + 12, &timeout, sizeof(timeout));
+          f->eax = (uint32_t) sys_poll(fds, nfds, timeout);
+          break;
+        }
       case SYS_SEEK:
         {
           int fd;
@@ -218,6 +360,74 @@ syscall_handler (struct intr_frame *f UNUSED)
             sys_munmap(mid);
             break;
           }
+
+        case SYS_SHM_MAP:
+          {
+            int key;
+            size_t size;
+            void *addr;
+            memread_user(f->esp + 4, &key, sizeof(key));
+            memread_user(f->esp + 8, &size, sizeof(size));
+            memread_user(f->esp + 12, &addr, sizeof(addr));
+
+            f->eax = sys_shm_map (key, size, addr);
+            break;
+          }
+
+        case SYS_MMAP_ANON:
+          {
+            void *addr;
+            size_t size;
+            memread_user(f->esp + 4, &addr, sizeof(addr));
+            memread_user(f->esp + 8, &size, sizeof(size));
+
+            f->eax = sys_mmap_anon (addr, size);
+            break;
+          }
+
+        case SYS_SBRK:
+          {
+            intptr_t increment;
+            memread_user(f->esp + 4, &increment, sizeof(increment));
+
+            f->eax = (uint32_t) sys_sbrk (increment);
+            break;
+          }
+
+        case SYS_MSYNC:
+          {
+            void *addr;
+            size_t length;
+            memread_user(f->esp + 4, &addr, sizeof(addr));
+            memread_user(f->esp + 8, &length, sizeof(length));
+
+            f->eax = sys_msync (addr, length);
+            break;
+          }
+
+        case SYS_MADVISE:
+          {
+            void *addr;
+            size_t length;
+            int advice;
+            memread_user(f->esp + 4, &addr, sizeof(addr));
+            memread_user(f->esp + 8, &length, sizeof(length));
+            memread_user(f->esp + 12, &advice, sizeof(advice));
+
+            f->eax = sys_madvise (addr, length, advice);
+            break;
+          }
+
+        case SYS_MUNMAP_RANGE:
+          {
+            void *addr;
+            size_t length;
+            memread_user(f->esp + 4, &addr, sizeof(addr));
+            memread_user(f->esp + 8, &length, sizeof(length));
+
+            f->eax = sys_munmap_range (addr, length);
+            break;
+          }
 #endif
 #ifdef FILESYS
         case SYS_CHDIR:
@@ -261,6 +471,8 @@ syscall_handler (struct intr_frame *f UNUSED)
         sys_exit(-1);
         break;
     }
+
+  trace (TRACE_SYSCALL_EXIT, 0, f->eax);
 }
 
 /****************** System Call Implementations ********************/
@@ -290,19 +502,82 @@ sys_exit(int status UNUSED)
 pid_t 
 sys_exec(const char *cmdline) 
 {
-  _DEBUG_PRINTF("[DEBUG] Exec : %s\n", cmdline);
+  /* copy the cmdline into kernel memory. */
+  char *kcmdline = copy_in_string (cmdline);
+  if (kcmdline == NULL)
+    return -1;
+  _DEBUG_PRINTF("[DEBUG] Exec : %s\n", kcmdline);
 
-  /* check the cmdline is in user mem. */
-  if (!validate_user_string (cmdline))
-    {
-      fail_invalid_access ();
-    }
-  
   /* load() uses filesystem. */
-    pid_t pid = process_execute(cmdline);
+  pid_t pid = process_execute(kcmdline);
+  palloc_free_page (kcmdline);
   return pid;
 }
 
+pid_t 
+sys_fork(const struct intr_frame *f) 
+{
+  _DEBUG_PRINTF("[DEBUG] Fork\n");
+  return process_fork(f);
+}
+
+/** Copies the calling thread's scheduling statistics to SELF,
+   unless it is null, and those of up to LOCK_CNT registered
+   kernel locks to LOCKS.  Returns the number of registered
+   locks. */
+int
+sys_schedstat(struct thread_stat *self, struct lock_stat *locks, int lock_cnt)
+{
+  if (self != NULL)
+    memwrite_user(self, &thread_current()->stats, sizeof *self);
+
+  int total = lock_get_stats(NULL, 0);
+  if (lock_cnt > total)
+    lock_cnt = total;
+  if (lock_cnt > 0)
+    {
+      /* Only a handful of locks are registered. */
+      struct lock_stat stats[lock_cnt];
+      lock_get_stats(stats, lock_cnt);
+      memwrite_user(locks, stats, sizeof stats);
+    }
+  return total;
+}
+
+/** Converts CYCLES of the time-stamp counter, which runs at HZ,
+   to microseconds. */
+static int64_t
+cycles_to_us(uint64_t cycles, uint64_t hz)
+{
+  if (hz == 0)
+    return 0;
+  return cycles / hz * 1000000 + cycles % hz * 1000000 / hz;
+}
+
+int
+sys_getrusage(int who, struct rusage *usage)
+{
+  struct thread *cur = thread_current();
+  uint64_t user, kernel;
+  uint64_t hz = timer_tsc_freq();
+  struct rusage ru;
+
+  if (who == RUSAGE_SELF)
+    thread_cpu_cycles(&user, &kernel);
+  else if (who == RUSAGE_CHILDREN)
+    {
+      user = cur->child_user_cycles;
+      kernel = cur->child_kernel_cycles;
+    }
+  else
+    return -1;
+
+  ru.utime = cycles_to_us(user, hz);
+  ru.stime = cycles_to_us(kernel, hz);
+  memwrite_user(usage, &ru, sizeof ru);
+  return 0;
+}
+
 int 
 sys_wait(pid_t pid) 
 {
@@ -314,58 +589,64 @@ bool
 sys_create(const char* filename, unsigned initial_size) 
 {
   bool return_code;
-  /* memory validation */
-  check_user((const uint8_t*) filename);
+  /* copy the name into kernel memory. */
+  char *kfilename = copy_in_string(filename);
+  if (kfilename == NULL)
+    return false;
 
-    return_code = filesys_create(filename, initial_size, false);
-    return return_code;
+  return_code = filesys_create(kfilename, initial_size, false);
+  palloc_free_page(kfilename);
+  return return_code;
 }
 
 bool 
 sys_remove(const char* filename) 
 {
   bool return_code;
-  /* memory validation */
-  check_user((const uint8_t*) filename);
+  /* copy the name into kernel memory. */
+  char *kfilename = copy_in_string(filename);
+  if (kfilename == NULL)
+    return false;
 
-    return_code = filesys_remove(filename);
+  return_code = filesys_remove(kfilename);
+  palloc_free_page(kfilename);
   return return_code;
 }
 
 int 
 sys_open(const char* file) 
 {
-  /* memory validation */
-  check_user((const uint8_t*) file);
+  /* copy the name into kernel memory. */
+  char *kfile = copy_in_string(file);
+  if (kfile == NULL)
+    return -1;
   
   struct file* file_opened;
-  struct file_desc* fd = palloc_get_page(0);
+  struct file_desc* desc = malloc(sizeof *desc);
 
-  if (!fd) {
+  if (!desc) {
+    palloc_free_page (kfile);
     return -1;
   }
 
-    file_opened = filesys_open(file);
+  file_opened = filesys_open(kfile);
+  palloc_free_page (kfile);
   if (!file_opened) {
-    palloc_free_page (fd);
+    free (desc);
       return -1;
   }
 
-  fd->file = file_opened;
-
-  struct list* fd_list = &thread_current ()->file_descriptors;
-  if (list_empty(fd_list)) 
-    {
-      /* 0, 1, 2 are reserved for stdin, stdout, stderr. */
-      fd->id = 3;
-    }
-  else 
-    {
-      fd->id = (list_entry(list_back(fd_list), struct file_desc, elem)->id) + 1;
-    }
-  list_push_back(fd_list, &(fd->elem));
-
-  return fd->id;
+  desc->file = file_opened;
+  desc->pipe = NULL;
+  desc->pipe_writer = false;
+  desc->cloexec = false;
+
+  /* the lowest free descriptor, from FD_FIRST up: 0, 1, 2 are
+    reserved for stdin, stdout, stderr. */
+  int fd = fd_table_install(&thread_current ()->fds, desc);
+  if (fd < 0)
+    file_desc_close (desc);
+  return fd;
 }
 
 int 
@@ -376,7 +657,7 @@ sys_filesize(int fd)
 
   file_d = find_file_desc(thread_current(), fd);
 
-  if(file_d == NULL) 
+  if(file_d == NULL || file_d->file == NULL) 
   {
       return -1;
   }
@@ -419,52 +700,57 @@ sys_close(int fd)
 {
     struct file_desc* file_d = find_file_desc(thread_current(), fd);
 
-  if(file_d && file_d->file) 
+  if(file_d) 
     {
-      if (!inode_is_dir(file_get_inode(file_d->file)))
-      {
-        file_close(file_d->file);
-        list_remove(&(file_d->elem));
-        palloc_free_page(file_d);
-      }else
-        {
-          dir_close(file_d->file);
-          list_remove(&(file_d->elem));
-          palloc_free_page(file_d);
-        }
+      fd_table_remove(&thread_current()->fds, fd);
+      file_desc_close(file_d);
     }
 }
 
 int 
 sys_read(int fd, void *buffer, unsigned size) 
 {
-   /* memory validation : [buffer+0, buffer+size) should be all valid. */
-   check_user((const uint8_t*) buffer);
-   check_user((const uint8_t*) buffer + size - 1);
+   /* memory validation : [buffer+0, buffer+size) should be in user space;
+      whether it is mapped is checked as it is accessed. */
+   check_user_range(buffer, size);
 
       int ret;
+  struct file_desc* file_d = find_file_desc(thread_current(), fd);
 
-  if(fd == 0) 
-    { /**< stdin */
-      unsigned i;
-      for(i = 0; i < size; ++i) 
+  if(file_d == NULL && fd == 0) 
+    { /**< stdin, through a kernel buffer */
+      uint8_t kbuf[64];
+      unsigned done, i, n;
+      for(done = 0; done < size; done += n) 
         {
-          if(! put_user(buffer + i, input_getc()) ) 
-            {
-                          sys_exit(-1); /**< segfault */
-            }
+          n = size - done < sizeof kbuf ? size - done : sizeof kbuf;
+          for(i = 0; i < n; ++i)
+            kbuf[i] = input_getc();
+          memwrite_user(buffer + done, kbuf, n);
         }
       ret = size;
     }
+  else if(file_d && file_d->pipe) 
+    { /**< read end of a pipe */
+      if (file_d->pipe_writer)
+        return -1;
+#ifdef VM
+      if (!preload_and_pin_pages(buffer, size, true))
+        fail_invalid_access();
+#endif
+      ret = pipe_read(file_d->pipe, buffer, size);
+#ifdef VM
+      unpin_preloaded_pages(buffer, size);
+#endif
+    }
   else 
     {
       /* read from file */
-      struct file_desc* file_d = find_file_desc(thread_current(), fd);
-
       if(file_d && file_d->file && !inode_is_dir(file_get_inode(file_d->file))) 
         {
 #ifdef VM
-          preload_and_pin_pages(buffer, size);
+          if (!preload_and_pin_pages(buffer, size, true))
+            fail_invalid_access();
 #endif
           ret = file_read(file_d->file, buffer, size);
 #ifdef VM
@@ -480,24 +766,54 @@ sys_read(int fd, void *buffer, unsigned size)
 
 int 
 sys_write(int fd, const void *buffer, unsigned size) {
-  /* memory validation : [buffer+0, buffer+size) should be all valid */
-  check_user((const uint8_t*) buffer);
-  check_user((const uint8_t*) buffer + size - 1);
+  /* memory validation : [buffer+0, buffer+size) should be in user space;
+     whether it is mapped is checked as it is accessed. */
+  check_user_range(buffer, size);
     int ret;
-  if(fd == 1) 
-    { /**< write to stdout */
-      putbuf(buffer, size);
+  struct file_desc* file_d = find_file_desc(thread_current(), fd);
+
+  if(file_d == NULL && fd == 1) 
+    { /**< write to stdout, through a kernel buffer.  A page is copied
+           at a time, so that short writes are not interleaved with
+           other output. */
+      char *kbuf = palloc_get_page(0);
+      unsigned done, n;
+      if (kbuf == NULL)
+        return -1;
+      for(done = 0; done < size; done += n)
+        {
+          n = size - done < PGSIZE ? size - done : PGSIZE;
+          if (copy_from_user(kbuf, buffer + done, n) != 0)
+            {
+              palloc_free_page(kbuf);
+              fail_invalid_access();
+            }
+          putbuf(kbuf, n);
+        }
+      palloc_free_page(kbuf);
       ret = size;
     }
+  else if(file_d && file_d->pipe) 
+    { /**< write end of a pipe */
+      if (!file_d->pipe_writer)
+        return -1;
+#ifdef VM
+      if (!preload_and_pin_pages(buffer, size, false))
+        fail_invalid_access();
+#endif
+      ret = pipe_write(file_d->pipe, buffer, size);
+#ifdef VM
+      unpin_preloaded_pages(buffer, size);
+#endif
+    }
   else 
     {
       /* write into file */
-      struct file_desc* file_d = find_file_desc(thread_current(), fd);
-
       if(file_d && file_d->file && !inode_is_dir(file_get_inode(file_d->file))) 
         {
 #ifdef VM
-          preload_and_pin_pages(buffer, size);
+          if (!preload_and_pin_pages(buffer, size, false))
+            fail_invalid_access();
 #endif
     
           ret = file_write(file_d->file, buffer, size);
@@ -512,6 +828,418 @@ sys_write(int fd, const void *buffer, unsigned size) {
   
   return ret;
 }
+
+int
+sys_pread(int fd, void *buffer, unsigned size, unsigned offset)
+{
+  check_user_range(buffer, size);
+
+  /* The console has no offset to read at, so fd 0 is not found. */
+  struct file_desc* file_d = find_file_desc(thread_current(), fd);
+  if(file_d == NULL || file_d->file == NULL
+     || inode_is_dir(file_get_inode(file_d->file))
+     || (off_t) offset < 0)
+    return -1;
+
+  int ret;
+#ifdef VM
+  if (!preload_and_pin_pages(buffer, size, true))
+    fail_invalid_access();
+#endif
+  ret = file_read_at(file_d->file, buffer, size, offset);
+#ifdef VM
+  unpin_preloaded_pages(buffer, size);
+#endif
+  return ret;
+}
+
+int
+sys_pwrite(int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  check_user_range(buffer, size);
+
+  struct file_desc* file_d = find_file_desc(thread_current(), fd);
+  if(file_d == NULL || file_d->file == NULL
+     || inode_is_dir(file_get_inode(file_d->file))
+     || (off_t) offset < 0)
+    return -1;
+
+  int ret;
+#ifdef VM
+  if (!preload_and_pin_pages(buffer, size, false))
+    fail_invalid_access();
+#endif
+  ret = file_write_at(file_d->file, buffer, size, offset);
+#ifdef VM
+  unpin_preloaded_pages(buffer, size);
+#endif
+  return ret;
+}
+
+int
+sys_readv(int fd, const struct iovec *uiov, int iovcnt)
+{
+  struct iovec iov[IOV_MAX];
+  int total, i, ret;
+
+  total = copy_in_iovec(iov, uiov, iovcnt);
+  if (total < 0)
+    return -1;
+
+  struct file_desc* file_d = find_file_desc(thread_current(), fd);
+  if(file_d == NULL || file_d->pipe)
+    { /**< the console or a pipe, one buffer after another */
+      for(ret = 0, i = 0; i < iovcnt; ++i)
+        {
+          int n = sys_read(fd, iov[i].iov_base, iov[i].iov_len);
+          if (n < 0)
+            return ret > 0 ? ret : -1;
+          ret += n;
+          if ((size_t) n < iov[i].iov_len)
+            break;
+        }
+    }
+  else
+    {
+      if(file_d->file && !inode_is_dir(file_get_inode(file_d->file)))
+        {
+#ifdef VM
+          if (!preload_and_pin_iovec(iov, iovcnt, true))
+            fail_invalid_access();
+#endif
+          ret = file_readv(file_d->file, iov, iovcnt);
+#ifdef VM
+          unpin_preloaded_iovec(iov, iovcnt);
+#endif
+        }
+      else /**< no such file or can't open */
+        ret = -1;
+    }
+  return ret;
+}
+
+int
+sys_writev(int fd, const struct iovec *uiov, int iovcnt)
+{
+  struct iovec iov[IOV_MAX];
+  int total, i, ret;
+
+  total = copy_in_iovec(iov, uiov, iovcnt);
+  if (total < 0)
+    return -1;
+
+  struct file_desc* file_d = find_file_desc(thread_current(), fd);
+  if(file_d == NULL || file_d->pipe)
+    { /**< the console or a pipe, one buffer after another */
+      for(ret = 0, i = 0; i < iovcnt; ++i)
+        {
+          int n = sys_write(fd, iov[i].iov_base, iov[i].iov_len);
+          if (n < 0)
+            return ret > 0 ? ret : -1;
+          ret += n;
+          if ((size_t) n < iov[i].iov_len)
+            break;
+        }
+    }
+  else
+    {
+      if(file_d->file && !inode_is_dir(file_get_inode(file_d->file)))
+        {
+#ifdef VM
+          if (!preload_and_pin_iovec(iov, iovcnt, false))
+            fail_invalid_access();
+#endif
+          ret = file_writev(file_d->file, iov, iovcnt);
+#ifdef VM
+          unpin_preloaded_iovec(iov, iovcnt);
+#endif
+        }
+      else /**< no such file or can't open */
+        ret = -1;
+    }
+  return ret;
+}
+
+int
+sys_copy_file_range(int fd_in, int fd_out, unsigned size)
+{
+  struct thread *cur = thread_current();
+  struct file_desc* in = find_file_desc(cur, fd_in);
+  if(in == NULL || in->file == NULL || inode_is_dir(file_get_inode(in->file)))
+    return -1;
+  if(size > INT32_MAX)
+    size = INT32_MAX;
+
+  struct file_desc* out = find_file_desc(cur, fd_out);
+  if((out == NULL && fd_out == 1) || (out != NULL && out->pipe != NULL))
+    { /**< to stdout or a pipe, through a kernel page */
+      if (out != NULL && !out->pipe_writer)
+        return -1;
+      char *kbuf = palloc_get_page(0);
+      unsigned done = 0;
+      if (kbuf == NULL)
+        return -1;
+      while (done < size)
+        {
+          int n = file_read(in->file, kbuf,
+                            size - done < PGSIZE ? size - done : PGSIZE);
+          if (n <= 0)
+            break;
+          if (out == NULL)
+            putbuf(kbuf, n);
+          else
+            {
+              int w = pipe_write(out->pipe, kbuf, n);
+              if (w < n)
+                { /* no reader left: put back what didn't go through. */
+                  if (w < 0)
+                    w = 0;
+                  file_seek(in->file, file_tell(in->file) - (n - w));
+                  done += w;
+                  break;
+                }
+            }
+          done += n;
+        }
+      palloc_free_page(kbuf);
+      return done > 0 || size == 0 || out == NULL ? (int) done : -1;
+    }
+
+  /* Between two files, through the buffer cache. */
+  if(out == NULL || out->file == NULL
+     || inode_is_dir(file_get_inode(out->file))
+     || file_get_inode(out->file) == file_get_inode(in->file))
+    return -1;
+  return file_copy(out->file, in->file, size);
+}
+
+bool
+sys_pipe(int *ufds)
+{
+  struct thread *cur = thread_current();
+  struct file_desc *ends[2];
+  int fds[2];
+  int i;
+
+  check_user_range(ufds, sizeof fds);
+
+  struct pipe *p = pipe_create();
+  if (p == NULL)
+    return false;
+
+  /* fds[0] is the read end, fds[1] the write end. */
+  for (i = 0; i < 2; i++)
+    {
+      ends[i] = malloc(sizeof *ends[i]);
+      if (ends[i] == NULL)
+        break;
+      ends[i]->file = NULL;
+      ends[i]->is_dir = false;
+      ends[i]->pipe = p;
+      ends[i]->pipe_writer = i == 1;
+      ends[i]->cloexec = false;
+    }
+  if (i == 2 && (fds[0] = fd_table_install(&cur->fds, ends[0])) >= 0)
+    {
+      if ((fds[1] = fd_table_install(&cur->fds, ends[1])) >= 0)
+        {
+          memwrite_user(ufds, fds, sizeof fds);
+          return true;
+        }
+      fd_table_remove(&cur->fds, fds[0]);
+    }
+
+  /* Out of memory: closing both ends frees P. */
+  while (i-- > 0)
+    free(ends[i]);
+  pipe_close(p, false);
+  pipe_close(p, true);
+  return false;
+}
+
+int
+sys_dup2(int old_fd, int new_fd)
+{
+  struct thread *cur = thread_current();
+  struct file_desc *old = find_file_desc(cur, old_fd);
+  struct file_desc *copy;
+
+  /* The console may only be duplicated by leaving it in place. */
+  if (old == NULL || new_fd < 0 || new_fd >= FD_MAX)
+    return -1;
+  if (old_fd == new_fd)
+    return new_fd;
+
+  copy = file_desc_dup(old);
+  if (copy == NULL)
+    return -1;
+  copy->cloexec = false;
+  sys_close(new_fd);
+  if (!fd_table_install_at(&cur->fds, new_fd, copy))
+    {
+      file_desc_close(copy);
+      return -1;
+    }
+  return new_fd;
+}
+
+/* Sets whether FD is closed in the processes that exec() starts,
+   rather than inherited.  Returns false if FD is not open. */
+bool
+sys_set_cloexec(int fd, bool cloexec)
+{
+  struct file_desc *desc = find_file_desc(thread_current(), fd);
+
+  if (desc == NULL)
+    return false;
+  desc->cloexec = cloexec;
+  return true;
+}
+
+int
+sys_poll(struct pollfd *ufds, int nfds, int timeout)
+{
+  struct pollfd *fds;
+  struct wait_queue_entry *entries;
+  struct semaphore wake;
+  struct timer timer;
+  int64_t start = timer_ticks(), ticks = 0;
+  int i, ready;
+
+  if (nfds < 0 || nfds > POLL_MAX)
+    return -1;
+  check_user_range(ufds, nfds * sizeof *fds);
+  fds = malloc((nfds + 1) * sizeof *fds);
+  entries = malloc((nfds + 1) * sizeof *entries);
+  if (fds == NULL || entries == NULL)
+    {
+      free(fds);
+      free(entries);
+      return -1;
+    }
+  if (copy_from_user(fds, ufds, nfds * sizeof *fds) != 0)
+    {
+      free(fds);
+      free(entries);
+      fail_invalid_access();
+    }
+
+  /* Get on every wait queue before looking at anything, so that
+     no event between looking and sleeping is missed. */
+  sema_init(&wake, 0);
+  for (i = 0; i < nfds; i++)
+    {
+      struct wait_queue *wq = poll_wait_queue(&fds[i]);
+      entries[i].sema = NULL;
+      if (wq != NULL)
+        wait_queue_add(wq, &entries[i], &wake);
+    }
+  if (timeout > 0)
+    {
+      ticks = DIV_ROUND_UP((int64_t) timeout * TIMER_FREQ, 1000);
+      timer_setup(&timer, poll_timeout, &wake);
+      timer_start(&timer, ticks);
+    }
+
+  for (;;)
+    {
+      ready = 0;
+      for (i = 0; i < nfds; i++)
+        {
+          fds[i].revents = poll_events(&fds[i]);
+          if (fds[i].revents != 0)
+            ready++;
+        }
+      if (ready > 0 || timeout == 0
+          || (timeout > 0 && timer_elapsed(start) >= ticks))
+        break;
+      sema_down(&wake);
+    }
+
+  if (timeout > 0)
+    timer_cancel(&timer);
+  for (i = 0; i < nfds; i++)
+    if (entries[i].sema != NULL)
+      wait_queue_remove(&entries[i]);
+  free(entries);
+
+  if (copy_to_user(ufds, fds, nfds * sizeof *fds) != 0)
+    {
+      free(fds);
+      fail_invalid_access();
+    }
+  free(fds);
+  return ready;
+}
+
+/** Returns the events of PFD that have happened: those asked for
+   in its EVENTS, along with POLLERR, POLLHUP and POLLNVAL, which
+   are always reported.  Regular files are always ready. */
+static short
+poll_events(const struct pollfd *pfd)
+{
+  struct file_desc *file_d;
+  short events = pfd->events | POLLERR | POLLHUP | POLLNVAL;
+
+  if (pfd->events & POLLEXIT)
+    {
+      struct process_control_block *pcb = process_find_child(pfd->fd);
+      if (pcb == NULL)
+        return POLLNVAL;
+      return pcb->exited ? POLLEXIT : 0;
+    }
+  if (pfd->fd < 0)
+    return 0;
+
+  file_d = find_file_desc(thread_current(), pfd->fd);
+  if (file_d == NULL && pfd->fd == 0)
+    { /**< stdin */
+      enum intr_level old_level = intr_disable();
+      bool empty = input_empty();
+      intr_set_level(old_level);
+      return empty ? 0 : POLLIN & events;
+    }
+  else if (file_d == NULL && pfd->fd == 1)
+    return POLLOUT & events;
+  else if (file_d == NULL)
+    return POLLNVAL;
+  else if (file_d->pipe)
+    return pipe_poll(file_d->pipe, file_d->pipe_writer) & events;
+  else
+    return (POLLIN | POLLOUT) & events;
+}
+
+/** Returns the wait queue that is woken when the events of PFD may
+   have changed, or a null pointer if they never change. */
+static struct wait_queue *
+poll_wait_queue(const struct pollfd *pfd)
+{
+  struct file_desc *file_d;
+
+  if (pfd->events & POLLEXIT)
+    {
+      struct process_control_block *pcb = process_find_child(pfd->fd);
+      return pcb != NULL ? &pcb->exit_waiters : NULL;
+    }
+  if (pfd->fd < 0)
+    return NULL;
+
+  file_d = find_file_desc(thread_current(), pfd->fd);
+  if (file_d == NULL && pfd->fd == 0)
+    return input_wait_queue();
+  else if (file_d != NULL && file_d->pipe)
+    return pipe_wait_queue(file_d->pipe);
+  else
+    return NULL;
+}
+
+/** Timer function for sys_poll(): wakes up the poller. */
+static void
+poll_timeout(struct timer *timer UNUSED, void *sema)
+{
+  sema_up(sema);
+}
+
 #ifdef VM
 mmapid_t sys_mmap(int fd, void *upage) {
   // check arguments
@@ -535,40 +1263,19 @@ mmapid_t sys_mmap(int fd, void *upage) {
   if(file_size == 0) goto MMAP_FAIL;
 
   /* 2. Mapping memory pages */
-  // First, ensure that all the page address is NON-EXIESENT.
-  size_t offset;
-  for (offset = 0; offset < file_size; offset += PGSIZE) {
-    void *addr = upage + offset;
-    if (vm_supt_has_entry(curr->supt, addr)) goto MMAP_FAIL;
-  }
-
-  // Now, map each page to filesystem
-  for (offset = 0; offset < file_size; offset += PGSIZE) {
-    void *addr = upage + offset;
-
-    size_t read_bytes = (offset + PGSIZE < file_size ? PGSIZE : file_size - offset);
-    size_t zero_bytes = PGSIZE - read_bytes;
-
-    vm_supt_install_filesys(curr->supt, addr,
-        f, offset, read_bytes, zero_bytes, /*writable*/true);
-  }
+  // First, ensure that the whole range is in user space and NON-EXIESENT.
+  void *uend = upage + ROUND_UP (file_size, PGSIZE);
+  if (uend > PHYS_BASE || uend < upage) goto MMAP_FAIL;
+  if (!mmap_range_is_free(curr, upage, uend)) goto MMAP_FAIL;
+
+  // Now, map the range to filesystem; pages are set up as touched.
+  if (!vm_supt_install_region(curr->supt, upage, f, 0, file_size,
+        ROUND_UP (file_size, PGSIZE) - file_size, /*writable*/true, VM_REGION_MMAP))
+    goto MMAP_FAIL;
 
   /* 3. Assign mmapid */
-  mmapid_t mid;
-  if (! list_empty(&curr->mmap_list)) {
-    mid = list_entry(list_back(&curr->mmap_list), struct mmap_desc, elem)->id + 1;
-  }
-  else mid = 1;
-
-  struct mmap_desc *mmap_d = (struct mmap_desc*) malloc(sizeof(struct mmap_desc));
-  mmap_d->id = mid;
-  mmap_d->file = f;
-  mmap_d->addr = upage;
-  mmap_d->size = file_size;
-  list_push_back (&curr->mmap_list, &mmap_d->elem);
-
   // OK, release and return the mid
-  return mid;
+  return add_mmap_desc (f, NULL, upage, file_size);
 
 
 MMAP_FAIL:
@@ -585,36 +1292,252 @@ bool sys_munmap(mmapid_t mid)
     return false; 
   }
 
-    {
-    /* Iterate through each page */
-    size_t offset, file_size = mmap_d->size;
-    for(offset = 0; offset < file_size; offset += PGSIZE) {
-      void *addr = mmap_d->addr + offset;
-      size_t bytes = (offset + PGSIZE < file_size ? PGSIZE : file_size - offset);
-      vm_supt_mm_unmap (curr->supt, curr->pagedir, addr, mmap_d->file, offset, bytes);
-    }
-
-    /* Free resources, and remove from the list. */
-    list_remove (& mmap_d->elem);
-    file_close (mmap_d->file);
-    free (mmap_d);
+  /* The regions left of a whole mapping are never split by removing
+    them, so this can't fail. */
+  void *end = mmap_d->addr + ROUND_UP (mmap_d->size, PGSIZE);
+  vm_supt_remove_range (curr->supt, mmap_d->addr, end);
+  unmap_pages (curr, mmap_d, mmap_d->addr, end);
+  free_mmap_desc (curr, mmap_d);
+  return true;
+}
+
+/* Writes the dirty pages of [UPAGE, UPAGE + LENGTH), which must lie in
+   one mapping, back to its file now rather than at munmap() or exit;
+   the pages stay mapped. Nothing to do for memory with no file.
+   Returns false if the range isn't part of a single mapping. */
+bool sys_msync(void *upage, size_t length) {
+  struct thread *curr = thread_current();
+  struct mmap_desc *mmap_d;
+  void *uend, *addr;
+
+  if (!user_range(upage, length, &uend)) return false;
+  mmap_d = find_mmap_desc_at(curr, upage, uend);
+  if (mmap_d == NULL) return false;
+  if (mmap_d->file == NULL) return true;
+
+  lock_acquire (&curr->supt->lock);
+  for (addr = upage; addr < uend; addr += PGSIZE) {
+    size_t offset = addr - mmap_d->addr;
+    size_t bytes = (offset + PGSIZE < mmap_d->size ? PGSIZE : mmap_d->size - offset);
+    vm_supt_msync (curr->supt, curr->pagedir, addr, mmap_d->file, offset, bytes);
+  }
+  lock_release (&curr->supt->lock);
+  return true;
+}
+
+/* Applies ADVICE, one of the MADV_* of <mman.h>, to
+   [UPAGE, UPAGE + LENGTH), which may span several mappings (see
+   vm_supt_advise()). Returns false if part of the range is not
+   mapped, or ADVICE is unknown. */
+bool sys_madvise(void *upage, size_t length, int advice) {
+  struct thread *curr = thread_current();
+  void *uend;
+  bool success;
+
+  if (!user_range(upage, length, &uend)) return false;
+  lock_acquire (&curr->supt->lock);
+  success = vm_supt_advise (curr->supt, curr->pagedir, upage, uend, advice);
+  lock_release (&curr->supt->lock);
+  return success;
+}
+
+/* Unmaps [UPAGE, UPAGE + LENGTH), which must lie in one file or
+   anonymous mapping, writing dirty file pages back as munmap() does.
+   The addresses stay reserved to the mapping, which goes away, file
+   and all, once none of it is left. Returns false if the range isn't
+   part of such a mapping, or on memory exhaustion. */
+bool sys_munmap_range(void *upage, size_t length) {
+  struct thread *curr = thread_current();
+  struct mmap_desc *mmap_d;
+  void *uend;
+
+  if (!user_range(upage, length, &uend)) return false;
+  mmap_d = find_mmap_desc_at(curr, upage, uend);
+  if (mmap_d == NULL || mmap_d->shm != NULL) return false;
+
+  if (!vm_supt_remove_range (curr->supt, upage, uend)) return false;
+  unmap_pages (curr, mmap_d, upage, uend);
+  if (vm_supt_range_is_free (curr->supt, mmap_d->addr,
+                             mmap_d->addr + ROUND_UP (mmap_d->size, PGSIZE)))
+    free_mmap_desc (curr, mmap_d);
+  return true;
+}
+
+/* Maps SIZE bytes of the shared memory segment KEY at UPAGE, creating
+   the segment, zero-filled, if no process maps it; it disappears with
+   its last mapping. Returns a mapping id that munmap() takes, or -1. */
+mmapid_t sys_shm_map(int key, size_t size, void *upage) {
+  struct thread *curr = thread_current();
+
+  if (upage == NULL || pg_ofs(upage) != 0 || size == 0) return -1;
+  size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  void *uend = upage + page_cnt * PGSIZE;
+  if (uend > PHYS_BASE || uend <= upage) return -1;
+  if (!mmap_range_is_free(curr, upage, uend)) return -1;
+
+  struct vm_shm *shm = vm_shm_open (key, page_cnt);
+  if (shm == NULL) return -1;
+  if (!vm_supt_install_shm (curr->supt, upage, page_cnt, shm)) {
+    vm_shm_close (shm);
+    return -1;
+  }
+  return add_mmap_desc (NULL, shm, upage, page_cnt * PGSIZE);
+}
+
+/* Maps SIZE bytes of private, zero-filled memory at UPAGE. Nothing
+   is allocated until a page is touched. Returns a mapping id that
+   munmap() takes, or -1. */
+mmapid_t sys_mmap_anon(void *upage, size_t size) {
+  struct thread *curr = thread_current();
+
+  if (upage == NULL || pg_ofs(upage) != 0 || size == 0) return -1;
+  size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  void *uend = upage + page_cnt * PGSIZE;
+  if (uend > PHYS_BASE || uend <= upage) return -1;
+  if (!mmap_range_is_free(curr, upage, uend)) return -1;
+
+  if (!vm_supt_install_region(curr->supt, upage, NULL, 0, 0,
+        page_cnt * PGSIZE, /*writable*/true, VM_REGION_ANON))
+    return -1;
+  return add_mmap_desc (NULL, NULL, upage, page_cnt * PGSIZE);
+}
+
+/* Moves the end of the heap by INCREMENT bytes, which may be
+   negative, and returns its previous end, or (void *) -1 if the
+   heap would shrink past its start or run into another mapping.
+   Pages the heap grows over are zero-filled on first touch; those
+   it leaves are released. */
+void *sys_sbrk(intptr_t increment) {
+  struct thread *curr = thread_current();
+  uint8_t *old_brk = curr->brk;
+  uint8_t *new_brk = old_brk + increment;
+
+  if (increment >= 0 ? new_brk < old_brk || new_brk > (uint8_t *) PHYS_BASE
+                     : new_brk > old_brk || new_brk < curr->heap_start)
+    return (void *) -1;
+
+  void *old_end = pg_round_up (old_brk);
+  void *new_end = pg_round_up (new_brk);
+  if (new_end > old_end) {
+    if (!mmap_range_is_free(curr, old_end, new_end))
+      return (void *) -1;
   }
+  else if (new_end < old_end) {
+    void *upage;
+    lock_acquire (&curr->supt->lock);
+    pagedir_clear_range (curr->pagedir, new_end, old_end);
+    for (upage = new_end; upage < old_end; upage += PGSIZE)
+      vm_supt_mm_unmap (curr->supt, curr->pagedir, upage, NULL, 0, PGSIZE);
+    lock_release (&curr->supt->lock);
+  }
+  vm_supt_resize_region (curr->supt, curr->heap_start, new_end);
 
+  curr->brk = new_brk;
+  return old_brk;
+}
+
+/* Checks that [ADDR, ADDR + LENGTH) is a non-empty range of user
+   pages starting at a page boundary, and sets *END to its end,
+   rounded up to one. */
+static bool
+user_range(void *addr, size_t length, void **end)
+{
+  if (addr == NULL || pg_ofs(addr) != 0 || length == 0) return false;
+  *end = addr + ROUND_UP (length, PGSIZE);
+  return *end <= PHYS_BASE && *end > addr;
+}
+
+/* Returns true if [START, END) can be mapped: no region is there,
+   and it is no hole left in a mapping by munmap_range(). */
+static bool
+mmap_range_is_free(struct thread *t, void *start, void *end)
+{
+  struct list_elem *e;
+
+  if (!vm_supt_range_is_free(t->supt, start, end)) return false;
+  for (e = list_begin(&t->mmap_list); e != list_end(&t->mmap_list);
+       e = list_next(e)) {
+    struct mmap_desc *desc = list_entry(e, struct mmap_desc, elem);
+    if (desc->addr < end && start < desc->addr + ROUND_UP (desc->size, PGSIZE))
+      return false;
+  }
   return true;
 }
+
+/* Unmaps the pages of [START, END) of the mapping MMAP_D, writing
+   back the dirty ones of a file mapping; their regions must be gone
+   already (vm_supt_remove_range). */
+static void
+unmap_pages(struct thread *t, struct mmap_desc *mmap_d, void *start, void *end)
+{
+  void *addr;
+
+  /* Drop the whole range from the page table at once, so that the
+    TLB is invalidated once rather than for every page. */
+  lock_acquire (&t->supt->lock);
+  pagedir_clear_range (t->pagedir, start, end);
+
+  for (addr = start; addr < end; addr += PGSIZE) {
+    size_t offset = addr - mmap_d->addr;
+    size_t bytes = (offset + PGSIZE < mmap_d->size ? PGSIZE : mmap_d->size - offset);
+    vm_supt_mm_unmap (t->supt, t->pagedir, addr, mmap_d->file, offset, bytes);
+  }
+  lock_release (&t->supt->lock);
+}
+
+/* Releases what is behind the mapping MMAP_D, none of which is mapped
+   anymore, and forgets it. */
+static void
+free_mmap_desc(struct thread *t, struct mmap_desc *mmap_d)
+{
+  if (mmap_d->shm != NULL)
+    vm_shm_close (mmap_d->shm);
+  else if (mmap_d->file != NULL)
+    vm_supt_drop_readahead (t->supt, mmap_d->file);
+  list_remove (& mmap_d->elem);
+  file_close (mmap_d->file);
+  free (mmap_d);
+}
+
+/* Records a new mapping of F (a file mapping), SHM (shared memory)
+   or neither (anonymous memory) at ADDR, and returns its id. */
+static mmapid_t
+add_mmap_desc(struct file *f, struct vm_shm *shm, void *addr, size_t size)
+{
+  struct thread *curr = thread_current();
+  mmapid_t mid;
+  if (! list_empty(&curr->mmap_list)) {
+    mid = list_entry(list_back(&curr->mmap_list), struct mmap_desc, elem)->id + 1;
+  }
+  else mid = 1;
+
+  struct mmap_desc *mmap_d = (struct mmap_desc*) malloc(sizeof(struct mmap_desc));
+  mmap_d->id = mid;
+  mmap_d->file = f;
+  mmap_d->shm = shm;
+  mmap_d->addr = addr;
+  mmap_d->size = size;
+  list_push_back (&curr->mmap_list, &mmap_d->elem);
+  return mid;
+}
 #endif
 #ifdef FILESYS
 bool sys_chdir(char* path, struct intr_frame *f)
 {
-    check_user((const uint8_t*) path);
-    bool success = filesys_chdir(path);
+    char *kpath = copy_in_string(path);
+    bool success = kpath != NULL && filesys_chdir(kpath);
+    if (kpath != NULL)
+      palloc_free_page(kpath);
     f->eax = success;
     return success;
 }
 
 bool sys_mkdir(char* path, struct intr_frame *f)
 {
-    bool success = filesys_create(path, 0, true);
+    char *kpath = copy_in_string(path);
+    bool success = kpath != NULL && filesys_create(kpath, 0, true);
+    if (kpath != NULL)
+      palloc_free_page(kpath);
     f->eax = success;
     return success;
   }
@@ -634,7 +1557,9 @@ bool sys_readdir(int fd, char* path, struct intr_frame *f)
     // struct dir* dir = dir_open(inode);
     struct dir* dir = (struct dir*) file;
     // if(dir == NULL) return false;
-    if(!dir_readdir(dir, path)) return false;
+    char name[NAME_MAX + 1];
+    if(!dir_readdir(dir, name)) return false;
+    memwrite_user(path, name, strlen(name) + 1);
     
     f->eax = true;
     return true;
@@ -682,85 +1607,86 @@ fail_invalid_access(void)
   NOT_REACHED();
 }
 
-/** check the whole user_string is in user mem. */
-static bool 
-validate_user_string(const char *uaddr) 
+/** check [uaddr, uaddr + bytes) lies in user space. */
+static void
+check_user_range (const void *uaddr, size_t bytes) 
 {
-  const char *p = uaddr;
-  size_t max_len = 1024; 
-  while (max_len--) {
-    int c = get_user((const uint8_t *)p);
-    if (c == -1) return false;
-    if (c == 0) return true;
-    p++;
-  }
-  return false;
+  if(!uaccess_ok (uaddr, bytes))
+    fail_invalid_access();
 }
 
-/** check a single byte is in user mem. */
-static void
-check_user (const uint8_t *uaddr) 
+/** Reads a consecutive `bytes` bytes of user memory with the
+  starting address `src` (uaddr), and writes to dst.
+  Returns the number of bytes read; exits the process on an
+  invalid access. */
+static int
+memread_user (void *src, void *dst, size_t bytes)
 {
-  /* check uaddr range or segfaults */
-  if(get_user (uaddr) == -1)
+  if(copy_from_user(dst, src, bytes) != 0) /**< segfault or invalid memory access */
     fail_invalid_access();
+  return (int)bytes;
 }
 
-/** Reads a single 'byte' at user memory admemory at 'uaddr'.
-  'uaddr' must be below PHYS_BASE.
- 
-  Returns the byte value if successful (extract the least significant byte),
-  or -1 in case of error (a segfault occurred or invalid uaddr) */
-static int32_t
-get_user (const uint8_t *uaddr) 
+/** Writes BYTES bytes from SRC to user memory at DST.
+  Returns the number of bytes written; exits the process on an
+  invalid access. */
+static int
+memwrite_user (void *dst, const void *src, size_t bytes)
 {
-  /* check that a user pointer `uaddr` points below PHYS_BASE*/
-  if (! ((void*)uaddr < PHYS_BASE))
-    return -1; /**< invalid memory access */
-
-  /* as suggested in the reference manual, see (3.1.5) */
-  int result;
-  asm ("movl $1f, %0; movzbl %1, %0; 1:"
-      : "=&a" (result) : "m" (*uaddr));
-  return result;
+  if(copy_to_user(dst, src, bytes) != 0)
+    fail_invalid_access();
+  return (int)bytes;
 }
 
-/** Writes a single byte (content is 'byte') to user address 'udst'.
-  'udst' must be below PHYS_BASE.
- 
-  Returns true if successful, false if a segfault occurred. */
-static bool
-put_user (uint8_t *udst, uint8_t byte) 
+/** Copies the user string USTR into a new page, which the caller
+  must free with palloc_free_page().  Returns NULL if the string
+  doesn't fit in a page, or memory is exhausted; exits the process
+  if USTR is not a valid user string. */
+static char *
+copy_in_string (const char *ustr)
 {
-  /* check that a user pointer `udst` points below PHYS_BASE */
-  if (! ((void*)udst < PHYS_BASE)) 
+  char *kstr = palloc_get_page(0);
+  if (kstr == NULL)
+    return NULL;
+
+  int len = strncpy_from_user(kstr, ustr, PGSIZE);
+  if (len < 0)
     {
-      return false;
+      palloc_free_page(kstr);
+      fail_invalid_access();
     }
-  int error_code;
-
-  /* as suggested in the reference manual, see (3.1.5) */
-  asm ("movl $1f, %0; movb %b2, %1; 1:"
-      : "=&a" (error_code), "=m" (*udst) : "q" (byte));
-  return error_code != -1;
+  if (len == PGSIZE)
+    {
+      palloc_free_page(kstr);
+      return NULL;
+    }
+  return kstr;
 }
 
-/** Reads a consecutive `bytes` bytes of user memory with the
-  starting address `src` (uaddr), and writes to dst.
-  Returns the number of bytes read, or -1 on page fault (invalid memory access) */
+/** Copies the IOVCNT-element array of buffers at user address UIOV
+  into IOV, which has room for IOV_MAX, and checks that each buffer
+  lies in user space.  Returns the total length of the buffers, or
+  -1 if IOVCNT is out of range or the total does not fit in an
+  off_t; exits the process on an invalid access. */
 static int
-memread_user (void *src, void *dst, size_t bytes)
+copy_in_iovec (struct iovec *iov, const struct iovec *uiov, int iovcnt)
 {
-  int32_t value;
-  size_t i;
-  for(i = 0; i < bytes; i++) 
+  size_t total = 0;
+  int i;
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return -1;
+  memread_user((void *) uiov, iov, iovcnt * sizeof *iov);
+  for (i = 0; i < iovcnt; i++)
     {
-      value = get_user(src + i);
-      if(value == -1) /**< segfault or invalid memory access */
-        fail_invalid_access();
-      *(char*)(dst + i) = value & 0xff;
+      if (iov[i].iov_len == 0)
+        continue;
+      check_user_range(iov[i].iov_base, iov[i].iov_len);
+      if (iov[i].iov_len > INT32_MAX - total)
+        return -1;
+      total += iov[i].iov_len;
     }
-  return (int)bytes;
+  return total;
 }
 
 /** Find file description. */
@@ -769,26 +1695,7 @@ find_file_desc(struct thread *t, int fd)
 {
   ASSERT (t != NULL);
 
-  if (fd < 3) 
-  {
-    return NULL;
-  }
-
-  struct list_elem *e;
-  if (! list_empty(&t->file_descriptors)) 
-  {
-    for(e = list_begin(&t->file_descriptors);
-        e != list_end(&t->file_descriptors); e = list_next(e))
-    {
-      struct file_desc *desc = list_entry(e, struct file_desc, elem);
-      if(desc->id == fd) 
-      {
-        return desc;
-      }
-    }
-  }
-
-  return NULL; /**< not found */
+  return fd_table_lookup(&t->fds, fd); /**< NULL if not found */
 }
 #ifdef VM
 static struct mmap_desc*
@@ -812,18 +1719,65 @@ find_mmap_desc(struct thread *t, mmapid_t mid)
   return NULL; // not found
 }
 
+/* Returns the mapping of T that [START, END) lies in, or NULL. */
+static struct mmap_desc*
+find_mmap_desc_at(struct thread *t, void *start, void *end)
+{
+  struct list_elem *e;
+
+  for(e = list_begin(&t->mmap_list); e != list_end(&t->mmap_list);
+      e = list_next(e))
+  {
+    struct mmap_desc *desc = list_entry(e, struct mmap_desc, elem);
+    if(desc->addr <= start
+       && end <= desc->addr + ROUND_UP (desc->size, PGSIZE)) {
+      return desc;
+    }
+  }
+
+  return NULL; // not found
+}
 
-void preload_and_pin_pages(const void *buffer, size_t size)
+
+/* Bring in [buffer, buffer+size) and pin it for the kernel to access.
+   If the kernel is going to WRITE there, copy-on-write pages are made
+   private first: the frame pinned must be the one that stays mapped.
+   Every page is checked, and the stack is grown as the page fault
+   handler would; returns false, with nothing left pinned, if some
+   page is not valid user memory, or is read-only and WRITE is true. */
+bool preload_and_pin_pages(const void *buffer, size_t size, bool write)
 {
-  struct supplemental_page_table *supt = thread_current()->supt;
-  uint32_t *pagedir = thread_current()->pagedir;
+  struct thread *curr = thread_current();
+  struct supplemental_page_table *supt = curr->supt;
+  uint32_t *pagedir = curr->pagedir;
 
   void *upage;
+  lock_acquire (&supt->lock);
   for(upage = pg_round_down(buffer); upage < buffer + size; upage += PGSIZE)
   {
-    vm_load_page (supt, pagedir, upage);
+    struct supplemental_page_table_entry *spte = vm_supt_lookup (supt, upage);
+    if (spte == NULL && upage >= PHYS_BASE - MAX_STACK_SIZE
+        && (uint8_t *) upage + PGSIZE > curr->current_esp
+        && vm_supt_grow_stack (supt, upage))
+      {
+        /* A buffer on the stack, above the stack pointer. */
+        vm_supt_install_zeropage (supt, upage);
+        spte = vm_supt_lookup (supt, upage);
+      }
+    if (spte == NULL || (write && !spte->writable)
+        || !vm_load_page (supt, pagedir, upage))
+      {
+        lock_release (&supt->lock);
+        if (upage > buffer)
+          unpin_preloaded_pages (buffer, upage - buffer);
+        return false;
+      }
+    if (write)
+      vm_supt_break_cow (supt, pagedir, upage);
     vm_pin_page (supt, upage);
   }
+  lock_release (&supt->lock);
+  return true;
 }
 
 void unpin_preloaded_pages(const void *buffer, size_t size)
@@ -831,10 +1785,39 @@ void unpin_preloaded_pages(const void *buffer, size_t size)
   struct supplemental_page_table *supt = thread_current()->supt;
 
   void *upage;
+  lock_acquire (&supt->lock);
   for(upage = pg_round_down(buffer); upage < buffer + size; upage += PGSIZE)
   {
     vm_unpin_page (supt, upage);
   }
+  lock_release (&supt->lock);
+}
+
+/* Bring in and pin each of the IOVCNT buffers of IOV, as
+   preload_and_pin_pages() does, so that a vectored read or write
+   finds them all resident.  Returns false, with nothing left
+   pinned, if any of them is not valid. */
+static bool
+preload_and_pin_iovec(const struct iovec *iov, int iovcnt, bool write)
+{
+  int i;
+  for(i = 0; i < iovcnt; ++i)
+    if(iov[i].iov_len > 0
+       && !preload_and_pin_pages(iov[i].iov_base, iov[i].iov_len, write))
+      {
+        unpin_preloaded_iovec(iov, i);
+        return false;
+      }
+  return true;
+}
+
+static void
+unpin_preloaded_iovec(const struct iovec *iov, int iovcnt)
+{
+  int i;
+  for(i = 0; i < iovcnt; ++i)
+    if(iov[i].iov_len > 0)
+      unpin_preloaded_pages(iov[i].iov_base, iov[i].iov_len);
 }
 
 #endif
@@ -6,11 +6,22 @@ typedef int pid_t;
 
 void syscall_init (void);
 
+/** The SYSENTER path, see sysenter.S. */
+struct intr_frame;
+void sysenter_entry (void);
+void syscall_handler_sysenter (struct intr_frame *);
+
 /** Syscall Functions definition. */
 void sys_halt (void);
 void sys_exit (int);
 pid_t sys_exec (const char *cmdline);
+pid_t sys_fork (const struct intr_frame *);
 int sys_wait (pid_t pid);
+struct thread_stat;
+struct lock_stat;
+int sys_schedstat (struct thread_stat *, struct lock_stat *, int lock_cnt);
+struct rusage;
+int sys_getrusage (int who, struct rusage *);
 bool sys_create (const char* filename, unsigned initial_size);
 bool sys_remove (const char* filename);
 int sys_open (const char* file);
@@ -21,6 +32,17 @@ unsigned sys_tell(int fd);
 void sys_close(int fd);
 int sys_read(int fd, void *buffer, unsigned size);
 int sys_write(int fd, const void *buffer, unsigned size);
+int sys_pread(int fd, void *buffer, unsigned size, unsigned offset);
+int sys_pwrite(int fd, const void *buffer, unsigned size, unsigned offset);
+struct iovec;
+int sys_readv(int fd, const struct iovec *iov, int iovcnt);
+int sys_writev(int fd, const struct iovec *iov, int iovcnt);
+int sys_copy_file_range(int fd_in, int fd_out, unsigned size);
+bool sys_pipe(int *fds);
+int sys_dup2(int old_fd, int new_fd);
+bool sys_set_cloexec(int fd, bool cloexec);
+struct pollfd;
+int sys_poll(struct pollfd *fds, int nfds, int timeout);
 #ifdef VM
 /* expose munmap() so that it can be call in sys_exit(); */
 bool sys_munmap (mmapid_t);
@@ -104,3 +104,49 @@ tss_update (void)
   ASSERT (tss != NULL);
   tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
 }
+
+/** Model-specific registers that configure SYSENTER.  See
+   [IA32-v3a] 4.8.7 "Fast System Calls". */
+#define MSR_SYSENTER_CS  0x174  /**< Kernel code segment. */
+#define MSR_SYSENTER_ESP 0x175  /**< Kernel stack pointer. */
+#define MSR_SYSENTER_EIP 0x176  /**< Kernel entry point. */
+#define CPUID_EDX_SEP 0x00000800  /**< CPUID(1).EDX: SYSENTER supported. */
+
+/** Writes VALUE to model-specific register MSR. */
+static void
+wrmsr (uint32_t msr, uint32_t value) 
+{
+  asm volatile ("wrmsr" : : "c" (msr), "a" (value), "d" (0));
+}
+
+/** Sets up the SYSENTER instruction to enter the kernel at ENTRY.
+   Unlike an interrupt, SYSENTER does not consult the TSS; it
+   loads the stack pointer from an MSR, which can't be updated
+   cheaply on every thread switch.  Instead, the MSR points to
+   the esp0 member of the TSS, which always holds the running
+   thread's kernel stack (see tss_update()), so ENTRY's first job
+   is to load its stack pointer from there.  Returns false if the
+   CPU does not support SYSENTER. */
+bool
+tss_enable_sysenter (void (*entry) (void)) 
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+  unsigned family, model, stepping;
+
+  ASSERT (tss != NULL);
+
+  asm volatile ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+
+  /* Early Pentium Pros report SEP but do not implement it. */
+  if ((edx & CPUID_EDX_SEP) == 0
+      || (family == 6 && model < 3 && stepping < 3))
+    return false;
+
+  wrmsr (MSR_SYSENTER_CS, SEL_KCSEG);
+  wrmsr (MSR_SYSENTER_ESP, (uint32_t) &tss->esp0);
+  wrmsr (MSR_SYSENTER_EIP, (uint32_t) entry);
+  return true;
+}
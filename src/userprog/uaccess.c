@@ -0,0 +1,77 @@
+#include "userprog/uaccess.h"
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+/** Entry in the fault fixup table, defined in usercopy.S. */
+struct uaccess_fixup
+  {
+    void *insn;                 /**< Instruction that may fault. */
+    void *fixup;                /**< Where to resume if it does. */
+  };
+
+extern const struct uaccess_fixup uaccess_fixups[];
+
+size_t uaccess_copy (void *dst, const void *src, size_t size);
+int uaccess_strncpy (char *dst, const char *src, size_t size);
+
+/** Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns the number of bytes that could NOT be copied, so
+   0 means success. */
+size_t
+copy_from_user (void *dst, const void *usrc, size_t size)
+{
+  if (!uaccess_ok (usrc, size))
+    return size;
+  return uaccess_copy (dst, usrc, size);
+}
+
+/** Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns the number of bytes that could NOT be copied, so
+   0 means success. */
+size_t
+copy_to_user (void *udst, const void *src, size_t size)
+{
+  if (!uaccess_ok (udst, size))
+    return size;
+  return uaccess_copy (udst, src, size);
+}
+
+/** Copies the null-terminated string at user address USRC into
+   DST, which has room for SIZE bytes.  Returns the length of the
+   string if it fits in SIZE bytes along with its null
+   terminator; SIZE if it does not, in which case DST is not
+   null-terminated; or -1 if USRC is not a valid user string. */
+int
+strncpy_from_user (char *dst, const char *usrc, size_t size)
+{
+  uintptr_t start = (uintptr_t) usrc;
+
+  if (start >= (uintptr_t) PHYS_BASE)
+    return -1;
+  if (size > (uintptr_t) PHYS_BASE - start)
+    {
+      /* The string would have to end before PHYS_BASE. */
+      int len = uaccess_strncpy (dst, usrc, (uintptr_t) PHYS_BASE - start);
+      return len == -1 || (uintptr_t) len == (uintptr_t) PHYS_BASE - start
+             ? -1 : len;
+    }
+  return uaccess_strncpy (dst, usrc, size);
+}
+
+/** Called by page_fault() for a fault in kernel mode that could
+   not be resolved.  If F's faulting instruction is one of the
+   user copy instructions, arranges for it to resume at the
+   matching fixup and returns true.  Otherwise, returns false. */
+bool
+uaccess_fixup (struct intr_frame *f)
+{
+  const struct uaccess_fixup *x;
+
+  for (x = uaccess_fixups; x->insn != NULL; x++)
+    if ((void *) f->eip == x->insn)
+      {
+        f->eip = (void (*) (void)) x->fixup;
+        return true;
+      }
+  return false;
+}
@@ -0,0 +1,33 @@
+#ifndef USERPROG_UACCESS_H
+#define USERPROG_UACCESS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/** Copying between kernel and user memory.
+
+   These are the only functions the kernel uses to access user
+   memory.  Each checks that the user range lies below PHYS_BASE,
+   then copies it in one pass; a page fault that the virtual
+   memory system cannot resolve ends the copy early rather than
+   killing the kernel. */
+
+/** Returns true if [UADDR, UADDR + SIZE) lies in user space.
+   This does not check whether the pages are mapped. */
+static inline bool
+uaccess_ok (const void *uaddr, size_t size)
+{
+  uintptr_t start = (uintptr_t) uaddr;
+  return start + size >= start && start + size <= (uintptr_t) PHYS_BASE;
+}
+
+size_t copy_from_user (void *dst, const void *usrc, size_t size);
+size_t copy_to_user (void *udst, const void *src, size_t size);
+int strncpy_from_user (char *dst, const char *usrc, size_t size);
+
+struct intr_frame;
+bool uaccess_fixup (struct intr_frame *);
+
+#endif /**< userprog/uaccess.h */
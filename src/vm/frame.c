@@ -1,18 +1,27 @@
 #include <hash.h>
 #include <list.h>
 #include <stdio.h>
+#include <string.h>
 #include "lib/kernel/hash.h"
 #include "lib/kernel/list.h"
 
 #include "vm/frame.h"
+#include "vm/shm.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "userprog/pagedir.h"
 #include "threads/vaddr.h"
 
-/* A global lock, to ensure critical sections on frame operations. */
+/* Locking: frame_lock protects the table itself (frame_map, frame_list
+   and the eviction cursor) and is only ever held for short, non-blocking
+   sections. The state of a frame is protected by its own lock, taken
+   with frame_lock held, never the other way round. evict_lock serializes
+   evictions, and is the only one held across the swap disk write, so that
+   lookups, pin/unpin and allocations that find a free page don't wait for
+   the disk. */
 static struct lock frame_lock;
+static struct lock evict_lock;
 
 /* A mapping from physical address to frame table entry. */
 static struct hash frame_map;
@@ -37,8 +46,14 @@ struct frame_table_entry
     struct hash_elem helem;    /**< see ::frame_map */
     struct list_elem lelem;    /**< see ::frame_list */
 
+    struct lock lock;          /**< Protects the members below. */
+
     void *upage;               /**< User (Virtual Memory) Address, pointer to page */
     struct thread *t;          /**< The associated thread. */
+    struct list sharers;       /**< Other (thread, upage) owners of the frame: after fork(),
+                                  where it is mapped read-only everywhere, or for shared memory. */
+    struct vm_shm *shm;        /**< The shared memory segment the page belongs to, or NULL. */
+    size_t shm_page;           /**< Index of the page in SHM. */
 
     bool pinned;               /**< Used to prevent a frame from being evicted, while it is acquiring some resources.
                                   If it is true, it is never evicted. */
@@ -47,14 +62,36 @@ struct frame_table_entry
 #endif
   };
 
+/* An additional owner of a frame, see frame_table_entry::sharers. */
+struct frame_sharer
+  {
+    struct thread *t;
+    void *upage;
+    struct list_elem elem;
+  };
+
 static struct frame_table_entry* pick_frame_to_evict(uint32_t* pagedir);
+static bool frame_claim (struct frame_table_entry *, uint32_t *pagedir);
+static bool frame_lock_owners (struct frame_table_entry *);
+static void frame_release_claim (struct frame_table_entry *);
+static void frame_unlock_owner (struct thread *);
+static bool frame_test_and_clear_accessed (struct frame_table_entry *);
+static void vm_frame_evict_shared (struct frame_table_entry *);
+static void vm_frame_evict_owned (struct frame_table_entry *);
+static void* vm_frame_do_allocate (enum palloc_flags flags, void *upage, bool can_evict);
+static void* vm_frame_evict (enum palloc_flags flags, void *upage);
 static void vm_frame_do_free (void *kpage, bool free_page);
+static struct frame_table_entry* vm_frame_lookup (void *kpage);
+static struct frame_table_entry* vm_frame_lookup_locked (void *kpage);
 
 /* Virtual memory init. */
 void
 vm_frame_init ()
 {
   lock_init (&frame_lock);
+  lock_register (&frame_lock, "frame table");
+  lock_init (&evict_lock);
+  lock_register (&evict_lock, "frame evict");
   hash_init (&frame_map, frame_hash_func, frame_less_func, NULL);
   list_init (&frame_list);
 #ifdef LRU
@@ -69,109 +106,358 @@ vm_frame_init ()
 void*
 vm_frame_allocate (enum palloc_flags flags, void *upage)
 {
-  lock_acquire (&frame_lock);
-
-  void *frame_page = palloc_get_page (PAL_USER | flags);
-  if (frame_page == NULL) 
-  {
-    /* page allocation failed. */
-
-    /* first, swap out the page */
-    struct frame_table_entry *f_evicted = pick_frame_to_evict( thread_current()->pagedir );
-
-#if DEBUG
-    printf("f_evicted: %x th=%x, pagedir = %x, up = %x, kp = %x, hash_size=%d\n", f_evicted, f_evicted->t,
-        f_evicted->t->pagedir, f_evicted->upage, f_evicted->kpage, hash_size(&frame_map));
-#endif
-    ASSERT (f_evicted != NULL && f_evicted->t != NULL);
-
-    /* clear the page mapping, and replace it with swap */
-    ASSERT (f_evicted->t->pagedir != (void*) 0xcccccccc);
-    pagedir_clear_page(f_evicted->t->pagedir, f_evicted->upage);
-
-    bool is_dirty =  pagedir_is_dirty(f_evicted->t->pagedir, f_evicted->upage)
-                     || pagedir_is_dirty(f_evicted->t->pagedir, f_evicted->kpage);
+  return vm_frame_do_allocate (flags, upage, true);
+}
 
-    swap_index_t swap_idx = vm_swap_out( f_evicted->kpage );
-    vm_supt_set_swap(f_evicted->t->supt, f_evicted->upage, swap_idx);
-    vm_supt_set_dirty(f_evicted->t->supt, f_evicted->upage, is_dirty);
-    vm_frame_do_free(f_evicted->kpage, true); /**< f_evicted is also invalidated. */
+/* Allocate a new frame only if one is free, without evicting
+   anybody. Returns NULL when the user pool is exhausted.
+   Used for speculative loads (fault-around, swap readahead),
+   which must never push out a page that is actually in use. */
+void*
+vm_frame_try_allocate (enum palloc_flags flags, void *upage)
+{
+  return vm_frame_do_allocate (flags, upage, false);
+}
 
-    frame_page = palloc_get_page (PAL_USER | flags);
-    ASSERT (frame_page != NULL); /**< should success in this chance. */
-  }
+static void*
+vm_frame_do_allocate (enum palloc_flags flags, void *upage, bool can_evict)
+{
+  void *frame_page = palloc_get_page (PAL_USER | flags);
+  if (frame_page == NULL)
+    /* page allocation failed: take over a frame in use, if allowed. */
+    return can_evict ? vm_frame_evict (flags, upage) : NULL;
 
   struct frame_table_entry *frame = malloc(sizeof(struct frame_table_entry));
   if(frame == NULL) 
   {
     /* frame allocation failed. a critical state or panic? */
-    lock_release (&frame_lock);
+    palloc_free_page (frame_page);
     return NULL;
   }
 
+  frame->kpage = frame_page;
+  lock_init (&frame->lock);
   frame->t = thread_current ();
   frame->upage = upage;
-  frame->kpage = frame_page;
   frame->pinned = true;         /**< can't be evicted yet */
+  list_init (&frame->sharers);
+  frame->shm = NULL;
 
   /* insert into hash table */
+  lock_acquire (&frame_lock);
   hash_insert (&frame_map, &frame->helem);
   list_push_back (&frame_list, &frame->lelem);
-
   lock_release (&frame_lock);
   return frame_page;
 }
 
+/* Swap out a frame of the current process (possibly shared with
+   others after fork()), or of shared memory, and hand it over to
+   UPAGE. The frame table entry is reused as is: only the owner
+   changes. Only one eviction runs at a time; frame_lock is not held
+   while the page is written out, the frame being pinned.
+   Returns NULL if no frame can be evicted. */
+static void*
+vm_frame_evict (enum palloc_flags flags, void *upage)
+{
+  lock_acquire (&evict_lock);
+
+  /* a page may have been freed while we were waiting. */
+  void *frame_page = palloc_get_page (PAL_USER | flags);
+  if (frame_page != NULL)
+  {
+    lock_release (&evict_lock);
+    palloc_free_page (frame_page);
+    return vm_frame_do_allocate (flags, upage, true);
+  }
+
+  /* first, pick and pin the victim, which comes claimed
+    (see frame_claim()). */
+  lock_acquire (&frame_lock);
+  struct frame_table_entry *f_evicted = pick_frame_to_evict( thread_current()->pagedir );
+  if (f_evicted == NULL)
+  {
+    /* everything is pinned, or not ours to take. */
+    lock_release (&frame_lock);
+    lock_release (&evict_lock);
+    return NULL;
+  }
+  ASSERT (f_evicted->t != NULL);
+  lock_acquire (&f_evicted->lock);
+  f_evicted->pinned = true;
+  lock_release (&f_evicted->lock);
+  lock_release (&frame_lock);
+
+#if DEBUG
+  printf("f_evicted: %x th=%x, pagedir = %x, up = %x, kp = %x, hash_size=%d\n", f_evicted, f_evicted->t,
+      f_evicted->t->pagedir, f_evicted->upage, f_evicted->kpage, hash_size(&frame_map));
+#endif
+
+  if (f_evicted->shm != NULL)
+    vm_frame_evict_shared (f_evicted);
+  else
+    vm_frame_evict_owned (f_evicted);
+
+  /* the frame is ours now; it stays pinned until mapped. */
+  lock_acquire (&f_evicted->lock);
+  f_evicted->t = thread_current ();
+  f_evicted->upage = upage;
+  f_evicted->shm = NULL;
+  lock_release (&f_evicted->lock);
+
+  lock_release (&evict_lock);
+
+  if (flags & PAL_ZERO)
+    memset (f_evicted->kpage, 0, PGSIZE);
+  return f_evicted->kpage;
+}
+
+/* Swap out F, a page of shared memory, whose segment is locked by
+   the caller: the page is cleared from every page table that maps it,
+   and written to a single swap slot that the segment keeps for all of
+   them. Each process finds it there on its next fault, so no SPTE --
+   of other processes, at that -- needs to be touched. Releases the
+   lock of the segment. */
+static void
+vm_frame_evict_shared (struct frame_table_entry *f)
+{
+  struct vm_shm *shm = f->shm;
+
+  lock_acquire (&f->lock);
+  pagedir_clear_page (f->t->pagedir, f->upage);
+  while (!list_empty (&f->sharers))
+  {
+    struct frame_sharer *s =
+      list_entry (list_pop_front (&f->sharers), struct frame_sharer, elem);
+    pagedir_clear_page (s->t->pagedir, s->upage);
+    free (s);
+  }
+  lock_release (&f->lock);
+
+  vm_shm_set_swap (shm, f->shm_page, vm_swap_out (f->kpage));
+  lock_release (&shm->lock);
+}
+
+/* Swap out F, a frame of one or more processes, whose SPTEs the
+   caller has claimed. Every owner gets a swap slot of its own for
+   the page: the owners of a frame shared copy-on-write go separate
+   ways once it is back in memory, each in a private frame. Releases
+   the locks of the other owners' tables. */
+static void
+vm_frame_evict_owned (struct frame_table_entry *f)
+{
+  struct thread *t = f->t;
+  void *upage = f->upage;
+
+  while (t != NULL)
+  {
+    /* clear the page mapping, and replace it with swap */
+    ASSERT (t->pagedir != (void*) 0xcccccccc);
+    pagedir_clear_page(t->pagedir, upage);
+
+    bool is_dirty =  pagedir_is_dirty(t->pagedir, upage)
+                     || pagedir_is_dirty(t->pagedir, f->kpage);
+
+    swap_index_t swap_idx = vm_swap_out( f->kpage );
+    vm_supt_set_swap(t->supt, upage, swap_idx);
+    vm_supt_set_dirty(t->supt, upage, is_dirty);
+    frame_unlock_owner (t);
+
+    /* on to the next owner, if any. */
+    t = NULL;
+    lock_acquire (&f->lock);
+    if (!list_empty (&f->sharers))
+    {
+      struct frame_sharer *s =
+        list_entry (list_pop_front (&f->sharers), struct frame_sharer, elem);
+      t = s->t;
+      upage = s->upage;
+      free (s);
+    }
+    lock_release (&f->lock);
+  }
+}
+
 /* Deallocate a frame or page. */
 void
 vm_frame_free (void *kpage)
 {
-  lock_acquire (&frame_lock);
   vm_frame_do_free (kpage, true);
-  lock_release (&frame_lock);
 }
 
 /* Just removes then entry from table, do not palloc free. */
 void
 vm_frame_remove_entry (void *kpage)
 {
-  lock_acquire (&frame_lock);
   vm_frame_do_free (kpage, false);
-  lock_release (&frame_lock);
 }
 
 /* An (internal, private) method --
-  Deallocates a frame or page (internal procedure)
-  MUST BE CALLED with 'frame_lock' held. */
+  Deallocates a frame or page (internal procedure). */
 void
 vm_frame_do_free (void *kpage, bool free_page)
 {
-  ASSERT (lock_held_by_current_thread(&frame_lock) == true);
   ASSERT (is_kernel_vaddr(kpage));
   ASSERT (pg_ofs (kpage) == 0); /**< should be aligned. */
 
-  /* hash lookup : a temporary entry */
-  struct frame_table_entry f_tmp;
-  f_tmp.kpage = kpage;
-
-  struct hash_elem *h = hash_find (&frame_map, &(f_tmp.helem));
-  if (h == NULL) 
+  lock_acquire (&frame_lock);
+  struct frame_table_entry *f = vm_frame_lookup_locked (kpage);
+  if (f == NULL) 
   {
     PANIC ("The page to be freed is not stored in the table");
   }
+  ASSERT (list_empty (&f->sharers)); /**< still mapped by somebody else? */
 
-  struct frame_table_entry *f;
-  f = hash_entry (h, struct frame_table_entry, helem);
-
+#ifndef LRU
+  /* don't leave the clock hand on a frame that is gone. */
+  if (clock_ptr == &f->lelem)
+    clock_ptr = list_prev (clock_ptr);
+#endif
   hash_delete (&frame_map, &f->helem);
   list_remove (&f->lelem);
+  lock_release (&f->lock);
+  lock_release (&frame_lock);
 
   /* Free resources. */
   if(free_page) palloc_free_page(kpage);
   free(f);
 }
+
+/* Whether F can be evicted to make room for PAGEDIR; if so, F is
+   claimed: the locks its eviction needs are held until the eviction
+   is done, or frame_release_claim(). That is the segment of a page of
+   shared memory, and the page tables of the other owners of a frame
+   shared after fork(). None of them, nor F's own lock, is waited
+   for, a busy frame being no good victim.
+   MUST BE CALLED with 'frame_lock' held. */
+static bool
+frame_claim (struct frame_table_entry *f, uint32_t *pagedir)
+{
+  if (!lock_try_acquire (&f->lock))
+    return false;
+
+  bool evictable;
+  if (f->pinned)
+    evictable = false;
+  else if (f->shm != NULL)
+    /* shared memory is tracked by its segment, not by the SPTEs of its
+      owners: it can go whoever maps it, unless the segment is busy. */
+    evictable = !lock_held_by_current_thread (&f->shm->lock)
+                && lock_try_acquire (&f->shm->lock);
+  else if (list_empty (&f->sharers))
+    /* only our own: that of another process would need its table's
+      lock, which is only taken for frames we share with it. */
+    evictable = f->t->pagedir == pagedir;
+  else
+  {
+    /* a frame shared after fork(): one of the owners must be us. */
+    struct list_elem *e;
+    evictable = f->t->pagedir == pagedir;
+    for (e = list_begin (&f->sharers); !evictable && e != list_end (&f->sharers);
+         e = list_next (e))
+      evictable = list_entry (e, struct frame_sharer, elem)->t->pagedir == pagedir;
+    evictable = evictable && frame_lock_owners (f);
+  }
+  lock_release (&f->lock);
+  return evictable;
+}
+
+/* Try to acquire the supplemental page tables of all owners of F
+   but the current thread. Fails, holding none of them, if any is
+   busy -- or held by the current thread, which is fork()ing off one
+   of the owners and is in the middle of its table.
+   F's lock must be held. */
+static bool
+frame_lock_owners (struct frame_table_entry *f)
+{
+  struct thread *curr = thread_current ();
+  struct list_elem *e;
+
+  if (f->t != curr)
+  {
+    if (lock_held_by_current_thread (&f->t->supt->lock)
+        || !lock_try_acquire (&f->t->supt->lock))
+      return false;
+  }
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers); e = list_next (e))
+  {
+    struct thread *t = list_entry (e, struct frame_sharer, elem)->t;
+    if (t == curr)
+      continue;
+    if (lock_held_by_current_thread (&t->supt->lock)
+        || !lock_try_acquire (&t->supt->lock))
+    {
+      /* roll back. */
+      while (e != list_begin (&f->sharers))
+      {
+        e = list_prev (e);
+        frame_unlock_owner (list_entry (e, struct frame_sharer, elem)->t);
+      }
+      frame_unlock_owner (f->t);
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Give up the claim on F, taken by frame_claim(), if it is not
+   evicted after all. MUST BE CALLED with 'frame_lock' held. */
+static void
+frame_release_claim (struct frame_table_entry *f)
+{
+  if (f->shm != NULL)
+  {
+    lock_release (&f->shm->lock);
+    return;
+  }
+
+  struct list_elem *e;
+  lock_acquire (&f->lock);
+  frame_unlock_owner (f->t);
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers); e = list_next (e))
+    frame_unlock_owner (list_entry (e, struct frame_sharer, elem)->t);
+  lock_release (&f->lock);
+}
+
+/* Release the supplemental page table of T, an owner of a claimed
+   frame, unless it is the current thread, which did not take it. */
+static void
+frame_unlock_owner (struct thread *t)
+{
+  if (t != thread_current ())
+    lock_release (&t->supt->lock);
+}
+
+/* Whether F has been accessed through any of its mappings since the
+   last call, clearing their accessed bits. A busy frame counts as
+   accessed. MUST BE CALLED with 'frame_lock' held. */
+static bool
+frame_test_and_clear_accessed (struct frame_table_entry *f)
+{
+  if (!lock_try_acquire (&f->lock))
+    return true;
+
+  bool accessed = pagedir_is_accessed (f->t->pagedir, f->upage);
+  if (accessed)
+    pagedir_set_accessed (f->t->pagedir, f->upage, false);
+
+  struct list_elem *e;
+  for (e = list_begin (&f->sharers); e != list_end (&f->sharers); e = list_next (e))
+  {
+    struct frame_sharer *s = list_entry (e, struct frame_sharer, elem);
+    if (pagedir_is_accessed (s->t->pagedir, s->upage))
+    {
+      pagedir_set_accessed (s->t->pagedir, s->upage, false);
+      accessed = true;
+    }
+  }
+  lock_release (&f->lock);
+  return accessed;
+}
+
 #ifdef LRU
-/* Select the least recently used frame to evict. */
+/* Select the least recently used frame to evict, or NULL if none
+   can be. MUST BE CALLED with 'frame_lock' held. */
 static struct frame_table_entry*
 pick_frame_to_evict(uint32_t* pagedir)
 {
@@ -183,8 +469,7 @@ pick_frame_to_evict(uint32_t* pagedir)
   for (e = list_begin(&frame_list); e != list_end(&frame_list); e = list_next(e))
   {
       struct frame_table_entry *f = list_entry(e, struct frame_table_entry, lelem);
-      /* TODO Other threads'pages could be evicted, too. */
-      if (f->pinned || f->t->pagedir != pagedir)
+      if (!frame_claim (f, pagedir))
           continue;
 
       /* Check and update access bit */
@@ -197,19 +482,24 @@ pick_frame_to_evict(uint32_t* pagedir)
           pagedir_set_accessed(f->t->pagedir, f->kpage, false);
       }
 
-      /* Track the least recently used */
+      /* Track the least recently used, keeping only its claim */
       if (f->last_used < min_last_used)
       {
+          if (victim != NULL)
+              frame_release_claim (victim);
           min_last_used = f->last_used;
           victim = f;
       }
+      else
+          frame_release_claim (f);
   }
 
-  ASSERT(victim != NULL);
   return victim;
 }
 #else
-/** Frame Eviction Strategy : The Clock Algorithm */
+/** Frame Eviction Strategy : The Clock Algorithm
+   Returns NULL if no frame can be evicted.
+   MUST BE CALLED with 'frame_lock' held. */
 struct frame_table_entry* clock_frame_next(void);
 struct frame_table_entry* pick_frame_to_evict( uint32_t *pagedir )
 {
@@ -220,15 +510,14 @@ struct frame_table_entry* pick_frame_to_evict( uint32_t *pagedir )
   for(it = 0; it <= n + n; ++ it) /**< prevent infinite loop. 2n iterations is enough. */
   {
     struct frame_table_entry *e = clock_frame_next();
-    /* if pinned, continue */
-    /* TODO Other threads'pages could be evicted, too. */
-    if(e->pinned || e->t->pagedir != pagedir)
+    /* if pinned (or not ours), continue */
+    if(!frame_claim (e, pagedir))
       continue;
     
     /* if referenced, give a second chance. */
-    else if( pagedir_is_accessed(pagedir, e->upage)) 
+    else if( frame_test_and_clear_accessed (e) )
     {
-      pagedir_set_accessed(pagedir, e->upage, false);
+      frame_release_claim (e);
       continue;
     }
 
@@ -236,7 +525,7 @@ struct frame_table_entry* pick_frame_to_evict( uint32_t *pagedir )
     return e;
   }
 
-  PANIC ("Can't evict any frame -- Not enough memory!\n");
+  return NULL;
 }
 struct frame_table_entry* clock_frame_next(void)
 {
@@ -256,21 +545,12 @@ struct frame_table_entry* clock_frame_next(void)
 static void
 vm_frame_set_pinned (void *kpage, bool new_value)
 {
-  lock_acquire (&frame_lock);
-
-  /* hash lookup : a temporary entry */
-  struct frame_table_entry f_tmp;
-  f_tmp.kpage = kpage;
-  struct hash_elem *h = hash_find (&frame_map, &(f_tmp.helem));
-  if (h == NULL) {
+  struct frame_table_entry *f = vm_frame_lookup (kpage);
+  if (f == NULL) {
     PANIC ("The frame to be pinned/unpinned does not exist");
   }
-
-  struct frame_table_entry *f;
-  f = hash_entry(h, struct frame_table_entry, helem);
   f->pinned = new_value;
-
-  lock_release (&frame_lock);
+  lock_release (&f->lock);
 }
 
 void
@@ -283,6 +563,145 @@ vm_frame_pin (void* kpage) {
   vm_frame_set_pinned (kpage, true);
 }
 
+/* Add (T, UPAGE) as one more owner of the frame KPAGE, which is
+   from now on shared copy-on-write. Returns false if out of memory. */
+bool
+vm_frame_share (void *kpage, struct thread *t, void *upage)
+{
+  struct frame_sharer *s = malloc (sizeof *s);
+  if (s == NULL)
+    return false;
+  s->t = t;
+  s->upage = upage;
+
+  struct frame_table_entry *f = vm_frame_lookup (kpage);
+  if (f == NULL)
+    PANIC ("The frame to be shared does not exist");
+  list_push_back (&f->sharers, &s->elem);
+  lock_release (&f->lock);
+  return true;
+}
+
+/* Remove (T, UPAGE) from the owners of the frame KPAGE, if it has
+   other owners; returns true in that case and the frame stays
+   allocated for them. Returns false, changing nothing, when
+   (T, UPAGE) is the only owner -- the caller then frees the frame. */
+bool
+vm_frame_unshare (void *kpage, struct thread *t, void *upage)
+{
+  struct frame_sharer *s = NULL;
+
+  struct frame_table_entry *f = vm_frame_lookup (kpage);
+  if (f == NULL)
+    PANIC ("The frame to be unshared does not exist");
+
+  if (!list_empty (&f->sharers))
+  {
+    if (f->t == t && f->upage == upage)
+    {
+      /* the primary owner leaves: promote a sharer. */
+      s = list_entry (list_pop_front (&f->sharers), struct frame_sharer, elem);
+      f->t = s->t;
+      f->upage = s->upage;
+    }
+    else
+    {
+      struct list_elem *e;
+      for (e = list_begin (&f->sharers); e != list_end (&f->sharers); e = list_next (e))
+      {
+        struct frame_sharer *cand = list_entry (e, struct frame_sharer, elem);
+        if (cand->t == t && cand->upage == upage)
+        {
+          list_remove (e);
+          s = cand;
+          break;
+        }
+      }
+    }
+    ASSERT (s != NULL);
+  }
+  lock_release (&f->lock);
+
+  bool unshared = s != NULL;
+  free (s);
+  return unshared;
+}
+
+/* Returns whether the frame KPAGE is mapped by more than one owner. */
+bool
+vm_frame_is_shared (void *kpage)
+{
+  struct frame_table_entry *f = vm_frame_lookup (kpage);
+  if (f == NULL)
+    PANIC ("The frame does not exist");
+  bool shared = !list_empty (&f->sharers);
+  lock_release (&f->lock);
+  return shared;
+}
+
+/* Returns whether (T, UPAGE) is one of the owners of the frame KPAGE. */
+bool
+vm_frame_is_owner (void *kpage, struct thread *t, void *upage)
+{
+  struct frame_table_entry *f = vm_frame_lookup (kpage);
+  if (f == NULL)
+    PANIC ("The frame does not exist");
+
+  bool owner = f->t == t && f->upage == upage;
+  struct list_elem *e;
+  for (e = list_begin (&f->sharers); !owner && e != list_end (&f->sharers);
+       e = list_next (e))
+  {
+    struct frame_sharer *s = list_entry (e, struct frame_sharer, elem);
+    owner = s->t == t && s->upage == upage;
+  }
+  lock_release (&f->lock);
+  return owner;
+}
+
+/* Record that the frame KPAGE holds page PAGE of the shared memory
+   segment SHM, which keeps track of it from now on. */
+void
+vm_frame_set_shm (void *kpage, struct vm_shm *shm, size_t page)
+{
+  struct frame_table_entry *f = vm_frame_lookup (kpage);
+  if (f == NULL)
+    PANIC ("The frame does not exist");
+  f->shm = shm;
+  f->shm_page = page;
+  lock_release (&f->lock);
+}
+
+/* Find the frame table entry of KPAGE, or NULL, and acquire its
+   lock, which the caller releases. */
+static struct frame_table_entry*
+vm_frame_lookup (void *kpage)
+{
+  lock_acquire (&frame_lock);
+  struct frame_table_entry *f = vm_frame_lookup_locked (kpage);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Same as vm_frame_lookup(), for callers holding 'frame_lock'. */
+static struct frame_table_entry*
+vm_frame_lookup_locked (void *kpage)
+{
+  ASSERT (lock_held_by_current_thread(&frame_lock) == true);
+
+  /* hash lookup : a temporary entry */
+  struct frame_table_entry f_tmp;
+  f_tmp.kpage = kpage;
+
+  struct hash_elem *h = hash_find (&frame_map, &(f_tmp.helem));
+  if (h == NULL)
+    return NULL;
+
+  struct frame_table_entry *f = hash_entry (h, struct frame_table_entry, helem);
+  lock_acquire (&f->lock);
+  return f;
+}
+
 /* Helpers */
 /* Hash Functions required for [frame_map]. Uses 'kpage' as key. */
 static unsigned frame_hash_func(const struct hash_elem *elem, void *aux UNUSED)
@@ -11,6 +11,7 @@
 /* Functions for Frame manipulation. */
 void vm_frame_init (void);
 void* vm_frame_allocate (enum palloc_flags flags, void *upage);
+void* vm_frame_try_allocate (enum palloc_flags flags, void *upage);
 
 void vm_frame_free (void*);
 void vm_frame_remove_entry (void*);
@@ -18,4 +19,13 @@ void vm_frame_remove_entry (void*);
 void vm_frame_pin (void* kpage);
 void vm_frame_unpin (void* kpage);
 
+struct thread;
+bool vm_frame_share (void *kpage, struct thread *t, void *upage);
+bool vm_frame_unshare (void *kpage, struct thread *t, void *upage);
+bool vm_frame_is_shared (void *kpage);
+bool vm_frame_is_owner (void *kpage, struct thread *t, void *upage);
+
+struct vm_shm;
+void vm_frame_set_shm (void *kpage, struct vm_shm *, size_t page);
+
 #endif /**< vm/frame.h */
@@ -1,4 +1,5 @@
 #include <hash.h>
+#include <mman.h>
 #include <string.h>
 #include "lib/kernel/hash.h"
 
@@ -6,15 +7,38 @@
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
 #include "userprog/pagedir.h"
 #include "vm/page.h"
 #include "vm/frame.h"
+#include "vm/shm.h"
 #include "filesys/file.h"
 
 static unsigned spte_hash_func(const struct hash_elem *elem, void *aux);
 static bool     spte_less_func(const struct hash_elem *, const struct hash_elem *, void *aux);
 static void     spte_destroy_func(struct hash_elem *elem, void *aux);
 
+static struct vm_region* vm_region_find (struct supplemental_page_table *, void *upage);
+static struct supplemental_page_table_entry* vm_supt_find (
+    struct supplemental_page_table *, void *upage);
+static struct supplemental_page_table_entry* vm_region_materialize (
+    struct supplemental_page_table *, struct vm_region *, void *upage);
+
+static struct vm_readahead* vm_readahead_get (struct supplemental_page_table *, struct file *);
+static size_t vm_readahead_advance (struct vm_readahead *, void *upage);
+static size_t vm_swap_in_ahead (struct supplemental_page_table *,
+    struct supplemental_page_table_entry *, void *kpage,
+    struct supplemental_page_table_entry *ahead[], void *ahead_kpages[]);
+static void vm_fault_around (struct supplemental_page_table *, uint32_t *pagedir,
+    struct supplemental_page_table_entry *);
+static void vm_drop_behind (struct supplemental_page_table *, uint32_t *pagedir,
+    struct supplemental_page_table_entry *, size_t cnt);
+static bool vm_prefetch_page (struct supplemental_page_table *, uint32_t *pagedir,
+    struct vm_region *, void *upage);
+static bool vm_install_prefetched (uint32_t *pagedir,
+    struct supplemental_page_table_entry *, void *kpage, bool writable);
+
 struct supplemental_page_table*
 vm_supt_create (void)
 {
@@ -22,6 +46,9 @@ vm_supt_create (void)
     (struct supplemental_page_table*) malloc(sizeof(struct supplemental_page_table));
 
   hash_init (&supt->page_map, spte_hash_func, spte_less_func, NULL);
+  list_init (&supt->readahead);
+  list_init (&supt->regions);
+  lock_init (&supt->lock);
   return supt;
 }
 
@@ -30,7 +57,14 @@ vm_supt_destroy (struct supplemental_page_table *supt)
 {
   ASSERT (supt != NULL);
 
+  /* once every shared frame is let go of, no evictor looks here. */
+  lock_acquire (&supt->lock);
   hash_destroy (&supt->page_map, spte_destroy_func);
+  lock_release (&supt->lock);
+  while (!list_empty (&supt->readahead))
+    free (list_entry (list_pop_front (&supt->readahead), struct vm_readahead, elem));
+  while (!list_empty (&supt->regions))
+    free (list_entry (list_pop_front (&supt->regions), struct vm_region, elem));
   free (supt);
 }
 
@@ -51,7 +85,9 @@ vm_supt_install_frame (struct supplemental_page_table *supt, void *upage, void *
   spte->kpage = kpage;
   spte->status = ON_FRAME;
   spte->dirty = false;
+  spte->cow = false;
   spte->swap_index = -1;
+  spte->writable = true;
 
   struct hash_elem *prev_elem;
   prev_elem = hash_insert (&supt->page_map, &spte->elem);
@@ -80,6 +116,8 @@ vm_supt_install_zeropage (struct supplemental_page_table *supt, void *upage)
   spte->kpage = NULL;
   spte->status = ALL_ZERO;
   spte->dirty = false;
+  spte->cow = false;
+  spte->writable = true;
 
   struct hash_elem *prev_elem;
   prev_elem = hash_insert (&supt->page_map, &spte->elem);
@@ -106,37 +144,263 @@ vm_supt_set_swap (struct supplemental_page_table *supt, void *page, swap_index_t
 }
 
 
-/** Install a new page (specified by the starting address `upage`)
-  on the supplemental page table, of type FROM_FILESYS. */
+/** Install the pages [upage, upage + read_bytes + zero_bytes) as a
+  single region of type `type`: the first `read_bytes` bytes come
+  from `file` at `offset`, the rest is zero. Nothing is allocated per
+  page. The caller makes sure the range is free.
+  Returns false if out of memory. */
 bool
-vm_supt_install_filesys (struct supplemental_page_table *supt, void *upage,
-    struct file * file, off_t offset, uint32_t read_bytes, uint32_t zero_bytes, bool writable)
+vm_supt_install_region (struct supplemental_page_table *supt, void *upage,
+    struct file * file, off_t offset, uint32_t read_bytes, uint32_t zero_bytes, bool writable,
+    enum vm_region_type type)
 {
-  struct supplemental_page_table_entry *spte;
-  spte = (struct supplemental_page_table_entry *) malloc(sizeof(struct supplemental_page_table_entry));
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT ((read_bytes + zero_bytes) % PGSIZE == 0);
+
+  struct vm_region *r = malloc (sizeof *r);
+  if (r == NULL)
+    return false;
+
+  r->type = type;
+  r->start = upage;
+  r->end = upage + read_bytes + zero_bytes;
+  r->file = file;
+  r->file_offset = offset;
+  r->read_bytes = read_bytes;
+  r->writable = writable;
+  r->shm = NULL;
+  list_push_back (&supt->regions, &r->elem);
+  return true;
+}
+
+/** Install the first `page_cnt` pages of the shared memory segment
+  `shm` at [upage, upage + page_cnt * PGSIZE), as a single region.
+  The caller makes sure the range is free, and holds a reference to
+  the segment until the region is removed.
+  Returns false if out of memory. */
+bool
+vm_supt_install_shm (struct supplemental_page_table *supt, void *upage,
+    size_t page_cnt, struct vm_shm *shm)
+{
+  ASSERT (pg_ofs (upage) == 0);
+
+  struct vm_region *r = malloc (sizeof *r);
+  if (r == NULL)
+    return false;
+
+  r->type = VM_REGION_SHM;
+  r->start = upage;
+  r->end = upage + page_cnt * PGSIZE;
+  r->file = NULL;
+  r->file_offset = 0;
+  r->read_bytes = 0;
+  r->writable = true;
+  r->shm = shm;
+  list_push_back (&supt->regions, &r->elem);
+  return true;
+}
+
+/** Returns true if no region overlaps [start, end), i.e. (since every
+  SPTE lies in a region) nothing at all is mapped there. */
+bool
+vm_supt_range_is_free (struct supplemental_page_table *supt, void *start, void *end)
+{
+  struct list_elem *e;
+  for (e = list_begin (&supt->regions); e != list_end (&supt->regions);
+       e = list_next (e))
+    {
+      struct vm_region *r = list_entry (e, struct vm_region, elem);
+      if (r->start < end && start < r->end)
+        return false;
+    }
+  return true;
+}
+
+/** Forget the regions over [start, end): those inside it go, those
+  sticking out of it are trimmed to what lies outside, and one
+  that spans it is split in two. The pages of the range must be
+  unmapped by the caller (vm_supt_mm_unmap), before or after.
+  Returns false, changing nothing, if out of memory for a split. */
+bool
+vm_supt_remove_range (struct supplemental_page_table *supt, void *start, void *end)
+{
+  struct list_elem *e, *next;
+
+  ASSERT (pg_ofs (start) == 0 && pg_ofs (end) == 0);
+  for (e = list_begin (&supt->regions); e != list_end (&supt->regions); e = next)
+    {
+      struct vm_region *r = list_entry (e, struct vm_region, elem);
+      next = list_next (e);
+      if (r->end <= start || end <= r->start)
+        continue;
+
+      if (r->start < start && end < r->end)
+        {
+          /* the range is a hole in the middle: R keeps the head,
+            TAIL takes what follows the hole. */
+          struct vm_region *tail = malloc (sizeof *tail);
+          if (tail == NULL)
+            return false;
+          *tail = *r;
+          tail->start = end;
+          tail->file_offset += end - r->start;
+          tail->read_bytes = r->read_bytes > (uint32_t) (end - r->start)
+                             ? r->read_bytes - (end - r->start) : 0;
+          list_insert (next, &tail->elem);
+          r->end = start;
+          if (r->read_bytes > (uint32_t) (start - r->start))
+            r->read_bytes = start - r->start;
+          return true;
+        }
+      else if (r->start < start)
+        {
+          /* keep the head. */
+          r->end = start;
+          if (r->read_bytes > (uint32_t) (start - r->start))
+            r->read_bytes = start - r->start;
+        }
+      else if (end < r->end)
+        {
+          /* keep the tail. */
+          uint32_t skip = end - r->start;
+          r->start = end;
+          r->file_offset += skip;
+          r->read_bytes = r->read_bytes > skip ? r->read_bytes - skip : 0;
+        }
+      else
+        {
+          list_remove (e);
+          free (r);
+        }
+    }
+  return true;
+}
+
+/** Move the end of the heap, which starts at `start`, to `end`. When
+  it shrinks, the pages dropped must have been unmapped already
+  (vm_supt_mm_unmap); when it grows, the caller makes sure the new
+  pages are free. The heap is told from other regions by its type:
+  an empty one shares its start with whatever comes after it. */
+void
+vm_supt_resize_region (struct supplemental_page_table *supt, void *start, void *end)
+{
+  struct list_elem *e;
+
+  ASSERT (pg_ofs (end) == 0);
+  for (e = list_begin (&supt->regions); e != list_end (&supt->regions);
+       e = list_next (e))
+    {
+      struct vm_region *r = list_entry (e, struct vm_region, elem);
+      if (r->type == VM_REGION_HEAP)
+        {
+          ASSERT (r->start == start && start <= end);
+          r->end = end;
+          return;
+        }
+    }
+  PANIC ("resize region - no heap at %p", start);
+}
+
+/** Extend the stack region down to UPAGE, which the stack grows into,
+  unless something else is mapped in between. The room for the stack
+  is taken as it grows rather than reserved up front, so that the
+  pages below it, up to MAX_STACK_SIZE, can still be mapped.
+  Returns false if the stack can't grow to UPAGE. */
+bool
+vm_supt_grow_stack (struct supplemental_page_table *supt, void *upage)
+{
+  struct list_elem *e;
+
+  ASSERT (pg_ofs (upage) == 0);
+  for (e = list_begin (&supt->regions); e != list_end (&supt->regions);
+       e = list_next (e))
+    {
+      struct vm_region *r = list_entry (e, struct vm_region, elem);
+      if (r->type == VM_REGION_STACK)
+        {
+          if (upage >= r->start)
+            return true;
+          if (!vm_supt_range_is_free (supt, upage, r->start))
+            return false;
+          r->start = upage;
+          return true;
+        }
+    }
+  return false;
+}
+
+/** Returns the region containing UPAGE, or NULL. */
+static struct vm_region*
+vm_region_find (struct supplemental_page_table *supt, void *upage)
+{
+  struct list_elem *e;
+  for (e = list_begin (&supt->regions); e != list_end (&supt->regions);
+       e = list_next (e))
+    {
+      struct vm_region *r = list_entry (e, struct vm_region, elem);
+      if (r->start <= upage && upage < r->end)
+        return r;
+    }
+  return NULL;
+}
+
+/** Create the SPTE of UPAGE, which belongs to region R and has none
+  yet: FROM_FILESYS if some of its bytes are in the file, ALL_ZERO
+  (e.g. BSS) otherwise, SHARED_MEM for shared memory. Returns NULL if out of memory, or if R is
+  the stack: it only grows through the page fault handler. */
+static struct supplemental_page_table_entry*
+vm_region_materialize (struct supplemental_page_table *supt,
+    struct vm_region *r, void *upage)
+{
+  if (r->type == VM_REGION_STACK)
+    return NULL;
+
+  struct supplemental_page_table_entry *spte = malloc (sizeof *spte);
+  if (spte == NULL)
+    return NULL;
+
+  uint32_t skip = upage - r->start;
+  uint32_t page_read_bytes = 0;
+  if (skip < r->read_bytes)
+    page_read_bytes = r->read_bytes - skip < PGSIZE ? r->read_bytes - skip : PGSIZE;
 
   spte->upage = upage;
   spte->kpage = NULL;
-  spte->status = FROM_FILESYS;
+  spte->status = page_read_bytes > 0 ? FROM_FILESYS : ALL_ZERO;
   spte->dirty = false;
-  spte->file = file;
-  spte->file_offset = offset;
-  spte->read_bytes = read_bytes;
-  spte->zero_bytes = zero_bytes;
-  spte->writable = writable;
+  spte->cow = false;
+  spte->file = page_read_bytes > 0 ? r->file : NULL;
+  spte->file_offset = r->file_offset + skip;
+  spte->read_bytes = page_read_bytes;
+  spte->zero_bytes = PGSIZE - page_read_bytes;
+  spte->writable = r->writable;
+  spte->shm = r->shm;
+  spte->shm_page = skip / PGSIZE;
+  if (r->type == VM_REGION_SHM)
+    spte->status = SHARED_MEM;
 
-  struct hash_elem *prev_elem;
-  prev_elem = hash_insert (&supt->page_map, &spte->elem);
-  if (prev_elem == NULL) return true;
-
-  /* there is already an entry -- impossible state */
-  PANIC("Duplicated SUPT entry for filesys-page");
-  return false;
+  hash_insert (&supt->page_map, &spte->elem);
+  return spte;
 }
 
 
+/** Returns the SPTE of PAGE if it has one already, NULL otherwise:
+  unlike vm_supt_lookup, a page never touched is left as it is. */
+static struct supplemental_page_table_entry*
+vm_supt_find (struct supplemental_page_table *supt, void *page)
+{
+  struct supplemental_page_table_entry spte_temp;
+  spte_temp.upage = page;
+
+  struct hash_elem *elem = hash_find (&supt->page_map, &spte_temp.elem);
+  if(elem == NULL)
+    return NULL;
+  return hash_entry(elem, struct supplemental_page_table_entry, elem);
+}
+
 /** Lookup the SUPT and find a SPTE object given the user page address.
-  returns NULL if no such entry is found. */
+  returns NULL if no such entry is found.
+  The SPTE of a page in a region is created here, on first lookup. */
 struct supplemental_page_table_entry*
 vm_supt_lookup (struct supplemental_page_table *supt, void *page)
 {
@@ -146,8 +410,13 @@ vm_supt_lookup (struct supplemental_page_table *supt, void *page)
   spte_temp.upage = page;
 
   struct hash_elem *elem = hash_find (&supt->page_map, &spte_temp.elem);
-  if(elem == NULL) return NULL;
-  return hash_entry(elem, struct supplemental_page_table_entry, elem);
+  if(elem != NULL)
+    return hash_entry(elem, struct supplemental_page_table_entry, elem);
+
+  /* Not touched yet, but it might be part of a region. */
+  struct vm_region *r = vm_region_find (supt, page);
+  if(r == NULL) return NULL;
+  return vm_region_materialize (supt, r, page);
 }
 
 /** Returns if the SUPT contains an SPTE entry given the user page address.*/
@@ -173,6 +442,10 @@ vm_supt_set_dirty (struct supplemental_page_table *supt, void *page, bool value)
 
 /**
   Load the page, specified by the address `upage`, back into the memory.
+
+  Pages of the same mapping that follow `upage` are brought in along
+  with it (fault-around for file pages, readahead for swapped pages),
+  as far as the mapping's adaptive window and the free frames allow.
  */
 bool
 vm_load_page(struct supplemental_page_table *supt, uint32_t *pagedir, void *upage)
@@ -191,6 +464,11 @@ vm_load_page(struct supplemental_page_table *supt, uint32_t *pagedir, void *upag
     return true;
   }
 
+  if(spte->status == SHARED_MEM) {
+    /* the segment knows where the page is, and maps it. */
+    return vm_shm_load_page (spte->shm, spte->shm_page, pagedir, upage, false);
+  }
+
   /* 2. Obtain a frame to store the page */
   void *frame_page = vm_frame_allocate(PAL_USER, upage);
   if(frame_page == NULL) {
@@ -198,7 +476,10 @@ vm_load_page(struct supplemental_page_table *supt, uint32_t *pagedir, void *upag
   }
 
   /* 3. Fetch the data into the frame */
-  bool writable = true;
+  bool writable = spte->writable;
+  struct supplemental_page_table_entry *ahead[VM_RA_MAX_PAGES];
+  void *ahead_kpages[VM_RA_MAX_PAGES];
+  size_t ahead_cnt = 0, i;
   switch (spte->status)
     {
       case ALL_ZERO:
@@ -210,8 +491,9 @@ vm_load_page(struct supplemental_page_table *supt, uint32_t *pagedir, void *upag
         break;
 
       case ON_SWAP:
-        /* Swap in: load the data from the swap disc */
-        vm_swap_in (spte->swap_index, frame_page);
+        /* Swap in: load the data from the swap disc,
+          together with the swapped pages that follow it. */
+        ahead_cnt = vm_swap_in_ahead (supt, spte, frame_page, ahead, ahead_kpages);
         break;
 
       case FROM_FILESYS:
@@ -220,7 +502,6 @@ vm_load_page(struct supplemental_page_table *supt, uint32_t *pagedir, void *upag
             vm_frame_free(frame_page);
             return false;
           }
-        writable = spte->writable;
         break;
 
       default:
@@ -232,31 +513,445 @@ vm_load_page(struct supplemental_page_table *supt, uint32_t *pagedir, void *upag
   if(!pagedir_set_page (pagedir, upage, frame_page, writable)) 
     {
       vm_frame_free(frame_page);
+      /* the pages read ahead are already out of swap; put them back. */
+      for (i = 0; i < ahead_cnt; i++)
+        {
+          vm_supt_set_swap (supt, ahead[i]->upage, vm_swap_out (ahead_kpages[i]));
+          vm_frame_free (ahead_kpages[i]);
+        }
       return false;
     }
 
   /* Make SURE to mapped kpage is stored in the SPTE. */
+  enum page_status loaded_from = spte->status;
   spte->kpage = frame_page;
   spte->status = ON_FRAME;
+  spte->cow = false;            /**< a fresh frame is private. */
 
   pagedir_set_dirty (pagedir, frame_page, false);
 
   /* unpin frame */
   vm_frame_unpin(frame_page);
 
+  /* 5. Map whatever came in along with the faulting page.
+    They live in the same page table, which exists by now. */
+  for (i = 0; i < ahead_cnt; i++)
+    if (!vm_install_prefetched (pagedir, ahead[i], ahead_kpages[i], ahead[i]->writable))
+      PANIC ("swap readahead: can't map a page next to a mapped one");
+  if (loaded_from == FROM_FILESYS)
+    vm_fault_around (supt, pagedir, spte);
+
   return true;
 }
 
-/** Clear map in frame, upage and kpage. */
+/** Swap in SPTE into KPAGE. The pages following it in the address
+  space whose contents sit in the following swap slots are read by
+  the same multi-sector request, into frames that happen to be free.
+  Those are returned in AHEAD[] / AHEAD_KPAGES[] (still unmapped),
+  and their count is returned. */
+static size_t
+vm_swap_in_ahead (struct supplemental_page_table *supt,
+    struct supplemental_page_table_entry *spte, void *kpage,
+    struct supplemental_page_table_entry *ahead[], void *ahead_kpages[])
+{
+  struct vm_readahead *ra = vm_readahead_get (supt, NULL);
+  size_t window = ra != NULL ? vm_readahead_advance (ra, spte->upage) : VM_RA_MIN_PAGES;
+  void *kpages[VM_RA_MAX_PAGES];
+  size_t cnt;
+
+  kpages[0] = kpage;
+  for (cnt = 1; cnt < window; cnt++)
+    {
+      void *upage = spte->upage + cnt * PGSIZE;
+      if (!is_user_vaddr (upage) || pd_no (upage) != pd_no (spte->upage))
+        break;
+
+      struct supplemental_page_table_entry *next = vm_supt_lookup (supt, upage);
+      if (next == NULL || next->status != ON_SWAP
+          || next->swap_index != spte->swap_index + cnt)
+        break;
+
+      kpages[cnt] = vm_frame_try_allocate (PAL_USER, upage);
+      if (kpages[cnt] == NULL)
+        break;
+      ahead[cnt - 1] = next;
+      ahead_kpages[cnt - 1] = kpages[cnt];
+    }
+
+  vm_swap_in_multi (spte->swap_index, cnt, kpages);
+  if (ra != NULL)
+    ra->next_upage = spte->upage + cnt * PGSIZE;
+  return cnt - 1;
+}
+
+/** Fault-around: SPTE's page has just been read from its file.
+  Bring in the pages that follow it in the same file mapping as well,
+  up to the mapping's readahead window, using free frames only. */
+static void
+vm_fault_around (struct supplemental_page_table *supt, uint32_t *pagedir,
+    struct supplemental_page_table_entry *spte)
+{
+  struct vm_readahead *ra = vm_readahead_get (supt, spte->file);
+  if (ra == NULL)
+    return;
+
+  size_t window = vm_readahead_advance (ra, spte->upage);
+  size_t i;
+  for (i = 1; i < window; i++)
+    {
+      void *upage = spte->upage + i * PGSIZE;
+      if (!is_user_vaddr (upage) || pd_no (upage) != pd_no (spte->upage))
+        break;
+
+      struct supplemental_page_table_entry *next = vm_supt_lookup (supt, upage);
+      if (next == NULL || next->status != FROM_FILESYS || next->file != spte->file
+          || next->file_offset != spte->file_offset + (off_t) (i * PGSIZE))
+        break;
+
+      void *kpage = vm_frame_try_allocate (PAL_USER, upage);
+      if (kpage == NULL)
+        break;
+      if (!vm_load_page_from_filesys (next, kpage)
+          || !vm_install_prefetched (pagedir, next, kpage, next->writable))
+        {
+          vm_frame_free (kpage);
+          break;
+        }
+    }
+  ra->next_upage = spte->upage + i * PGSIZE;
+
+  if (ra->advice == MADV_SEQUENTIAL)
+    vm_drop_behind (supt, pagedir, spte, window);
+}
+
+/** Drop-behind, for a mapping read sequentially: the CNT pages before
+  SPTE's in its file have been read through, and are not expected to
+  be touched again. Clear their accessed bits, so that the clock hand
+  takes them before anything else. */
+static void
+vm_drop_behind (struct supplemental_page_table *supt, uint32_t *pagedir,
+    struct supplemental_page_table_entry *spte, size_t cnt)
+{
+  size_t i;
+  for (i = 1; i <= cnt && (uintptr_t) spte->upage >= i * PGSIZE; i++)
+    {
+      struct supplemental_page_table_entry *prev =
+        vm_supt_find (supt, spte->upage - i * PGSIZE);
+      if (prev == NULL || prev->status != ON_FRAME || prev->file != spte->file)
+        break;
+
+      pagedir_set_accessed (pagedir, prev->upage, false);
+      pagedir_set_accessed (pagedir, prev->kpage, false);
+    }
+}
+
+/** Bring UPAGE, a page of region R, in ahead of its first touch, if
+  it lives in its file or in swap, using a free frame only. Returns
+  false if there was none (or on memory exhaustion), true otherwise. */
+static bool
+vm_prefetch_page (struct supplemental_page_table *supt, uint32_t *pagedir,
+    struct vm_region *r, void *upage)
+{
+  /* only a page read from the file is worth an SPTE of its own; any
+    other page that was never touched is zero, and stays lazy. */
+  struct supplemental_page_table_entry *spte;
+  if (r->file != NULL && (uint32_t) (upage - r->start) < r->read_bytes)
+    spte = vm_supt_lookup (supt, upage);
+  else
+    spte = vm_supt_find (supt, upage);
+  if (spte == NULL
+      || (spte->status != FROM_FILESYS && spte->status != ON_SWAP))
+    return true;
+
+  void *kpage = vm_frame_try_allocate (PAL_USER, upage);
+  if (kpage == NULL)
+    return false;
+
+  if (spte->status == FROM_FILESYS)
+    {
+      if (!vm_load_page_from_filesys (spte, kpage)
+          || !vm_install_prefetched (pagedir, spte, kpage, spte->writable))
+        {
+          vm_frame_free (kpage);
+          return false;
+        }
+    }
+  else
+    {
+      vm_swap_in (spte->swap_index, kpage);
+      if (!vm_install_prefetched (pagedir, spte, kpage, spte->writable))
+        {
+          /* don't lose the contents. */
+          vm_supt_set_swap (supt, upage, vm_swap_out (kpage));
+          vm_frame_free (kpage);
+          return false;
+        }
+    }
+  return true;
+}
+
+/** Map a page that was brought in ahead of being touched. The fresh
+  PTE has its accessed bit clear, so the clock hand passes over it
+  first if it turns out not to be needed. */
+static bool
+vm_install_prefetched (uint32_t *pagedir,
+    struct supplemental_page_table_entry *spte, void *kpage, bool writable)
+{
+  if (!pagedir_set_page (pagedir, spte->upage, kpage, writable))
+    return false;
+
+  spte->kpage = kpage;
+  spte->status = ON_FRAME;
+  spte->cow = false;
+  vm_frame_unpin (kpage);
+  return true;
+}
+
+/** Returns the readahead state of the mapping backed by FILE
+  (NULL: swap), creating it on first use. Returns NULL if out of
+  memory, in which case no readahead is done. */
+static struct vm_readahead*
+vm_readahead_get (struct supplemental_page_table *supt, struct file *file)
+{
+  struct list_elem *e;
+  for (e = list_begin (&supt->readahead); e != list_end (&supt->readahead);
+       e = list_next (e))
+    {
+      struct vm_readahead *ra = list_entry (e, struct vm_readahead, elem);
+      if (ra->file == file)
+        return ra;
+    }
+
+  struct vm_readahead *ra = malloc (sizeof *ra);
+  if (ra == NULL)
+    return NULL;
+  ra->file = file;
+  ra->next_upage = NULL;
+  ra->window = VM_RA_MIN_PAGES;
+  ra->advice = MADV_NORMAL;
+  list_push_back (&supt->readahead, &ra->elem);
+  return ra;
+}
+
+/** A fault at UPAGE hit mapping RA. Grow the window if the fault is
+  where a sequential scan would land, shrink it back otherwise, and
+  return the number of pages to bring in (UPAGE included). Advice
+  pins the window at either bound instead. */
+static size_t
+vm_readahead_advance (struct vm_readahead *ra, void *upage)
+{
+  if (ra->advice == MADV_RANDOM)
+    ra->window = VM_RA_MIN_PAGES;
+  else if (ra->advice == MADV_SEQUENTIAL)
+    ra->window = VM_RA_MAX_PAGES;
+  else if (upage == ra->next_upage)
+    ra->window = ra->window * 2 < VM_RA_MAX_PAGES ? ra->window * 2 : VM_RA_MAX_PAGES;
+  else
+    ra->window = VM_RA_MIN_PAGES;
+  return ra->window;
+}
+
+/** Forget the readahead state of the mapping backed by FILE,
+  which is about to be unmapped. */
+void
+vm_supt_drop_readahead (struct supplemental_page_table *supt, struct file *file)
+{
+  struct list_elem *e;
+  for (e = list_begin (&supt->readahead); e != list_end (&supt->readahead);
+       e = list_next (e))
+    {
+      struct vm_readahead *ra = list_entry (e, struct vm_readahead, elem);
+      if (ra->file == file)
+        {
+          list_remove (e);
+          free (ra);
+          return;
+        }
+    }
+}
+
+/** Resolve a write fault on UPAGE, a page shared copy-on-write
+  after fork(). The last owner of the frame takes it over by just
+  making it writable; the others get a private copy.
+  Returns false if UPAGE isn't a copy-on-write page (or on
+  memory exhaustion): the fault is then a genuine violation. */
+bool
+vm_supt_break_cow (struct supplemental_page_table *supt, uint32_t *pagedir, void *upage)
+{
+  struct supplemental_page_table_entry *spte = vm_supt_lookup (supt, upage);
+  if (spte == NULL || !spte->cow)
+    return false;
+
+  /* not in memory: it comes back into a private frame anyway. */
+  if (spte->status != ON_FRAME)
+    {
+      spte->cow = false;
+      return true;
+    }
+
+  void *old_kpage = spte->kpage;
+  vm_frame_pin (old_kpage);
+
+  if (!vm_frame_is_shared (old_kpage))
+    {
+      pagedir_set_writable (pagedir, upage, true);
+      vm_frame_unpin (old_kpage);
+    }
+  else
+    {
+      void *new_kpage = vm_frame_allocate (PAL_USER, upage);
+      if (new_kpage == NULL)
+        {
+          vm_frame_unpin (old_kpage);
+          return false;
+        }
+      memcpy (new_kpage, old_kpage, PGSIZE);
+
+      spte->dirty = spte->dirty || pagedir_is_dirty (pagedir, upage);
+      pagedir_clear_page (pagedir, upage);
+      if (!pagedir_set_page (pagedir, upage, new_kpage, true))
+        PANIC ("copy-on-write: can't remap a page that was mapped");
+
+      /* the others might all be gone by now. */
+      if (vm_frame_unshare (old_kpage, thread_current (), upage))
+        vm_frame_unpin (old_kpage);
+      else
+        vm_frame_free (old_kpage);
+
+      spte->kpage = new_kpage;
+      vm_frame_unpin (new_kpage);
+    }
+
+  spte->cow = false;
+  return true;
+}
+
+/** Duplicate the address space described by SRC (mapped by
+  SRC_PAGEDIR) into DST for fork(). Pages in memory are shared
+  between the two processes, copy-on-write if writable; CHILD is
+  recorded as the new owner of those frames. Swapped out pages are
+  copied, everything else (regions included) stays lazy. File
+  pointers are mapped through TRANSLATE, since the child owns its
+  own open files. The caller holds the locks of both tables.
+  Returns false on memory exhaustion; DST must then be destroyed. */
+bool
+vm_supt_fork (struct supplemental_page_table *dst, uint32_t *dst_pagedir,
+    struct thread *child, struct supplemental_page_table *src, uint32_t *src_pagedir,
+    struct file *(*translate) (struct file *, void *aux), void *aux)
+{
+  struct hash_iterator i;
+
+  hash_first (&i, &src->page_map);
+  while (hash_next (&i))
+    {
+      struct supplemental_page_table_entry *p =
+        hash_entry (hash_cur (&i), struct supplemental_page_table_entry, elem);
+      struct supplemental_page_table_entry *c = malloc (sizeof *c);
+      if (c == NULL)
+        return false;
+
+      *c = *p;
+      if (p->status == FROM_FILESYS)
+        c->file = translate (p->file, aux);
+
+      /* in before the frame is shared: an evictor of the frame
+        updates the SPTE of each of its owners. */
+      hash_insert (&dst->page_map, &c->elem);
+
+      switch (p->status)
+        {
+          case ON_FRAME:
+            vm_frame_pin (p->kpage);
+            p->dirty = p->dirty || pagedir_is_dirty (src_pagedir, p->upage);
+            c->dirty = p->dirty;
+            if (p->writable)
+              {
+                pagedir_set_writable (src_pagedir, p->upage, false);
+                p->cow = c->cow = true;
+              }
+            if (!vm_frame_share (p->kpage, child, p->upage))
+              {
+                vm_frame_unpin (p->kpage);
+                hash_delete (&dst->page_map, &c->elem);
+                free (c);
+                return false;
+              }
+            if (!pagedir_set_page (dst_pagedir, p->upage, p->kpage, false))
+              {
+                /* hand the frame back to its other owners. */
+                vm_frame_unshare (p->kpage, child, p->upage);
+                vm_frame_unpin (p->kpage);
+                hash_delete (&dst->page_map, &c->elem);
+                free (c);
+                return false;
+              }
+            vm_frame_unpin (p->kpage);
+            break;
+
+          case ON_SWAP:
+            {
+              /* a swap slot has one owner: read it into a private frame. */
+              void *kpage = vm_frame_allocate (PAL_USER, p->upage);
+              if (kpage == NULL)
+                {
+                  hash_delete (&dst->page_map, &c->elem);
+                  free (c);
+                  return false;
+                }
+              vm_swap_read (p->swap_index, kpage);
+              if (!pagedir_set_page (dst_pagedir, p->upage, kpage, p->writable))
+                {
+                  vm_frame_free (kpage);
+                  hash_delete (&dst->page_map, &c->elem);
+                  free (c);
+                  return false;
+                }
+              c->status = ON_FRAME;
+              c->kpage = kpage;
+              c->swap_index = -1;
+              vm_frame_unpin (kpage);
+            }
+            break;
+
+          case ALL_ZERO:
+          case FROM_FILESYS:
+          case SHARED_MEM:
+            /* the child finds shared memory through the segment. */
+            break;
+
+          default:
+            PANIC ("unreachable state");
+        }
+    }
+
+  struct list_elem *e;
+  for (e = list_begin (&src->regions); e != list_end (&src->regions);
+       e = list_next (e))
+    {
+      struct vm_region *r = malloc (sizeof *r);
+      if (r == NULL)
+        return false;
+      *r = *list_entry (e, struct vm_region, elem);
+      if (r->file != NULL)
+        r->file = translate (r->file, aux);
+      list_push_back (&dst->regions, &r->elem);
+    }
+  return true;
+}
+
+/** Clear map in frame, upage and kpage. Dirty pages are written
+  back to `f` at `offset`, unless `f` is NULL: anonymous memory is
+  just dropped. */
 bool
 vm_supt_mm_unmap(
     struct supplemental_page_table *supt, uint32_t *pagedir,
     void *page, struct file *f, off_t offset, size_t bytes)
 {
-  struct supplemental_page_table_entry *spte = vm_supt_lookup(supt, page);
-  if(spte == NULL) {
-    PANIC ("munmap - some page is missing; can't happen!");
-  }
+  /* a page never touched has no SPTE, and there is nothing to do:
+    look at the hash only, not to materialize it just now. */
+  struct supplemental_page_table_entry *spte = vm_supt_find (supt, page);
+  if(spte == NULL)
+    return true;
 
   /* Pin the associated frame if loaded
     otherwise, a page fault could occur while 
@@ -279,40 +974,44 @@ vm_supt_mm_unmap(
       bool is_dirty = spte->dirty;
       is_dirty = is_dirty || pagedir_is_dirty(pagedir, spte->upage);
       is_dirty = is_dirty || pagedir_is_dirty(pagedir, spte->kpage);
-      if(is_dirty) 
-        file_write_at (f, spte->upage, bytes, offset);
+      /* (through the kernel address: the user mapping may
+        already be gone, see pagedir_clear_range) */
+      if(is_dirty && f != NULL) 
+        file_write_at (f, spte->kpage, bytes, offset);
       
-      /* clear the page mapping, and release the frame */
-      vm_frame_free (spte->kpage);
+      /* clear the page mapping, and release the frame
+        unless a fork()ed relative still maps it. */
       pagedir_clear_page (pagedir, spte->upage);
+      if (vm_frame_unshare (spte->kpage, thread_current (), spte->upage))
+        vm_frame_unpin (spte->kpage);
+      else
+        vm_frame_free (spte->kpage);
       break;
 
     case ON_SWAP:
       {
         bool is_dirty = spte->dirty;
         is_dirty = is_dirty || pagedir_is_dirty(pagedir, spte->upage);
-        if (is_dirty) 
-          {
-            /* load from swap, and write back to file */
-            void *tmp_page = palloc_get_page(0); // in the kernel
-            vm_swap_in (spte->swap_index, tmp_page);
-            file_write_at (f, tmp_page, PGSIZE, offset);
-            palloc_free_page(tmp_page);
-          }
-        else 
-          {
-            /* just throw away the swap. */
-            vm_swap_free (spte->swap_index);
-          }
+        /* write back to file straight from the swap disk,
+          then throw away the swap. */
+        if (is_dirty && f != NULL) 
+          vm_swap_write_to_file (spte->swap_index, f, offset, bytes);
+        vm_swap_free (spte->swap_index);
       }
       break;
 
+    case ALL_ZERO:
+      /* looked up, but never brought in. */
     case FROM_FILESYS:
       /* do nothing. */
       break;
 
+    case SHARED_MEM:
+      vm_shm_unmap_page (spte->shm, spte->shm_page, spte->upage);
+      break;
+
     default:
-      /* Impossible, such as ALL_ZERO */
+      /* Impossible */
     PANIC ("unreachable state");
   }
 
@@ -320,15 +1019,128 @@ vm_supt_mm_unmap(
    so that the unmapped memory is unreachable. Later 
    access will fault. */
   hash_delete(& supt->page_map, &spte->elem);
+  free (spte);
   return true;
 }
 
-static bool vm_load_page_from_filesys(struct supplemental_page_table_entry *spte, void *kpage)
+/** Write PAGE back to `f` at `offset` if it is dirty, and mark it
+  clean; unlike vm_supt_mm_unmap(), the page stays where it is. A
+  swapped page is written straight from its swap slot. */
+void
+vm_supt_msync (struct supplemental_page_table *supt, uint32_t *pagedir,
+    void *page, struct file *f, off_t offset, size_t bytes)
+{
+  struct supplemental_page_table_entry *spte = vm_supt_find (supt, page);
+  if(spte == NULL)
+    return;
+
+  switch (spte->status)
+  {
+    case ON_FRAME:
+      ASSERT (spte->kpage != NULL);
+      vm_frame_pin (spte->kpage);
+      if (spte->dirty || pagedir_is_dirty (pagedir, spte->upage)
+          || pagedir_is_dirty (pagedir, spte->kpage))
+        {
+          spte->dirty = false;
+          pagedir_set_dirty (pagedir, spte->upage, false);
+          pagedir_set_dirty (pagedir, spte->kpage, false);
+          file_write_at (f, spte->kpage, bytes, offset);
+        }
+      vm_frame_unpin (spte->kpage);
+      break;
+
+    case ON_SWAP:
+      if (spte->dirty)
+        {
+          vm_swap_write_to_file (spte->swap_index, f, offset, bytes);
+          spte->dirty = false;
+        }
+      break;
+
+    default:
+      /* nothing was written. */
+      break;
+  }
+}
+
+/** Apply madvise() ADVICE to [start, end), every page of which must
+  lie in some region:
+   - MADV_NORMAL, MADV_RANDOM, MADV_SEQUENTIAL set how readahead
+     treats the mappings over the range (the whole of each);
+   - MADV_WILLNEED reads the pages in from their file or swap now,
+     as far as free frames allow;
+   - MADV_DONTNEED drops the pages: a file mapping's dirty pages are
+     written back, anonymous contents are lost, and the pages come
+     back from their region on the next touch. Stack and shared
+     memory pages are left alone.
+  Returns false if part of the range is unmapped, or ADVICE is
+  unknown. */
+bool
+vm_supt_advise (struct supplemental_page_table *supt, uint32_t *pagedir,
+    void *start, void *end, int advice)
 {
-  file_seek (spte->file, spte->file_offset);
+  struct vm_region *r;
+  void *upage;
+
+  if (advice < MADV_NORMAL || advice > MADV_DONTNEED)
+    return false;
+  for (upage = start; upage < end; upage = r->end)
+    if ((r = vm_region_find (supt, upage)) == NULL)
+      return false;
 
-  /* read bytes from the file */
-  int n_read = file_read (spte->file, kpage, spte->read_bytes);
+  for (upage = start; upage < end; upage = r->end)
+    {
+      void *r_end;
+
+      r = vm_region_find (supt, upage);
+      r_end = r->end < end ? r->end : end;
+      switch (advice)
+        {
+          case MADV_NORMAL:
+          case MADV_RANDOM:
+          case MADV_SEQUENTIAL:
+            /* only file mappings have a readahead state of their own. */
+            if (r->file != NULL)
+              {
+                struct vm_readahead *ra = vm_readahead_get (supt, r->file);
+                if (ra != NULL)
+                  ra->advice = advice;
+              }
+            break;
+
+          case MADV_WILLNEED:
+            /* shared memory is brought in by its segment. */
+            if (r->type == VM_REGION_SHM)
+              break;
+            for (; upage < r_end; upage += PGSIZE)
+              if (!vm_prefetch_page (supt, pagedir, r, upage))
+                return true;
+            break;
+
+          case MADV_DONTNEED:
+            if (r->type == VM_REGION_STACK || r->type == VM_REGION_SHM)
+              break;
+            for (; upage < r_end; upage += PGSIZE)
+              {
+                uint32_t skip = upage - r->start;
+                size_t bytes = 0;
+                if (skip < r->read_bytes)
+                  bytes = r->read_bytes - skip < PGSIZE ? r->read_bytes - skip : PGSIZE;
+                vm_supt_mm_unmap (supt, pagedir, upage,
+                    r->type == VM_REGION_MMAP ? r->file : NULL,
+                    r->file_offset + skip, bytes);
+              }
+            break;
+        }
+    }
+  return true;
+}
+
+static bool vm_load_page_from_filesys(struct supplemental_page_table_entry *spte, void *kpage)
+{
+  /* read bytes from the file; positional, so no seek is needed */
+  int n_read = file_read_at (spte->file, kpage, spte->read_bytes, spte->file_offset);
   if(n_read != (int)spte->read_bytes)
     return false;
 
@@ -350,6 +1162,14 @@ vm_pin_page(struct supplemental_page_table *supt, void *page)
     return;
   }
 
+  if (spte->status == SHARED_MEM) {
+    /* (brings the page back if it was evicted after being loaded) */
+    if (!vm_shm_load_page (spte->shm, spte->shm_page,
+                           thread_current ()->pagedir, page, true))
+      PANIC ("pin page - out of memory for shared memory");
+    return;
+  }
+
   ASSERT (spte->status == ON_FRAME);
   vm_frame_pin (spte->kpage);
 }
@@ -365,6 +1185,9 @@ vm_unpin_page(struct supplemental_page_table *supt, void *page)
   if (spte->status == ON_FRAME) {
     vm_frame_unpin (spte->kpage);
   }
+  else if (spte->status == SHARED_MEM) {
+    vm_shm_unpin_page (spte->shm, spte->shm_page);
+  }
 }
 
 
@@ -391,8 +1214,14 @@ spte_destroy_func(struct hash_elem *elem, void *aux UNUSED)
   /* Clean up the associated frame */
   if (entry->kpage != NULL) 
     {
+      struct thread *cur = thread_current ();
       ASSERT (entry->status == ON_FRAME);
-      vm_frame_remove_entry (entry->kpage);
+      /* A frame shared with a relative must survive pagedir_destroy(),
+        which frees every page still mapped. */
+      if (vm_frame_unshare (entry->kpage, cur, entry->upage))
+        pagedir_clear_page (cur->pagedir, entry->upage);
+      else
+        vm_frame_remove_entry (entry->kpage);
     }
   else if(entry->status == ON_SWAP) 
     {
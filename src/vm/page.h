@@ -3,7 +3,19 @@
 
 #include "vm/swap.h"
 #include <hash.h>
+#include <list.h>
 #include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct vm_shm;
+
+/** Maximum size of the user stack. Its VM_REGION_STACK region only
+  covers the pages it has grown into (see vm_supt_grow_stack). */
+#define MAX_STACK_SIZE 0x800000
+
+/** Bounds of the per-mapping fault-around / readahead window, in pages. */
+#define VM_RA_MIN_PAGES 1
+#define VM_RA_MAX_PAGES 8
 
 /** Indicates a state of page. */
 enum page_status 
@@ -11,7 +23,8 @@ enum page_status
   ALL_ZERO,         /**< All zeros */
   ON_FRAME,         /**< Actively in memory */
   ON_SWAP,          /**< Swapped (on swap slot) */
-  FROM_FILESYS      /**< from filesystem (or executable) */
+  FROM_FILESYS,     /**< from filesystem (or executable) */
+  SHARED_MEM        /**< in a shared memory segment, which knows where */
 };
 
 /**
@@ -21,6 +34,67 @@ struct supplemental_page_table
   {
     /* The hash table, page -> spte */
     struct hash page_map;
+
+    /* Readahead state, one struct vm_readahead per mapping. */
+    struct list readahead;
+
+    /* Ranges of pages with no SPTE yet (struct vm_region). */
+    struct list regions;
+
+    /* Held by the process while it works on its SPTEs (page faults,
+       pinning, unmapping, fork(), exit). The evictor of a frame that
+       the process shares copy-on-write with others updates its SPTE
+       from another process, and only ever tries this lock. */
+    struct lock lock;
+  };
+
+/** What a region of the address space is. */
+enum vm_region_type
+{
+  VM_REGION_SEGMENT,  /**< ELF segment */
+  VM_REGION_MMAP,     /**< File mapped by mmap() */
+  VM_REGION_STACK,    /**< Room for the stack to grow into */
+  VM_REGION_SHM,      /**< Shared memory mapped by shm_map() */
+  VM_REGION_ANON,     /**< Zero-filled memory mapped by mmap_anon() */
+  VM_REGION_HEAP      /**< The heap, moved by sbrk() */
+};
+
+/**
+  A range of pages of the address space, described as a whole
+  (a VMA). The SPTE of one of its pages is only created when the
+  page is first looked up (see vm_supt_lookup), so the cost of
+  setting up a mapping doesn't depend on its size. Every SPTE
+  lies in some region.
+
+  Stack pages are the exception to the lazy creation: they only
+  come into existence when the page fault handler grows the stack.
+ */
+struct vm_region
+  {
+    enum vm_region_type type;
+    void *start, *end;        /**< Page-aligned bounds, [start, end). */
+    struct file *file;        /**< Backing file, NULL for the stack. */
+    off_t file_offset;        /**< Offset of `start` in the file. */
+    uint32_t read_bytes;      /**< Bytes to read from the file; the rest is zero. */
+    bool writable;
+    struct vm_shm *shm;       /**< Shared memory segment, for VM_REGION_SHM. */
+    struct list_elem elem;
+  };
+
+/**
+  Adaptive readahead window of one mapping: a file mapping
+  (executable or mmap), or anonymous memory living in swap
+  (file == NULL). The window doubles while faults stay
+  sequential and falls back to VM_RA_MIN_PAGES otherwise,
+  unless madvise() said how the mapping is going to be used.
+ */
+struct vm_readahead
+  {
+    struct file *file;        /**< Backing file, NULL for swap. */
+    void *next_upage;         /**< Where a sequential fault would hit next. */
+    size_t window;            /**< Pages to bring in on the next fault. */
+    int advice;               /**< MADV_NORMAL, MADV_RANDOM or MADV_SEQUENTIAL. */
+    struct list_elem elem;
   };
 
 struct supplemental_page_table_entry
@@ -34,6 +108,8 @@ struct supplemental_page_table_entry
     enum page_status status;
 
     bool dirty;               /**< Dirty bit. */
+    bool cow;                 /**< Shared with a fork()ed relative and mapped
+                                 read-only; a write fault makes it private. */
 
     /* for ON_SWAP */
     swap_index_t swap_index;  /**< Stores the swap index if the page is swapped out.
@@ -43,7 +119,11 @@ struct supplemental_page_table_entry
     struct file *file;
     off_t file_offset;
     uint32_t read_bytes, zero_bytes;
-    bool writable;
+    bool writable;            /**< Writable by the user, once private. */
+
+    /* for SHARED_MEM */
+    struct vm_shm *shm;
+    size_t shm_page;          /**< Index of the page in SHM. */
   };
 
 
@@ -56,8 +136,15 @@ void vm_supt_destroy (struct supplemental_page_table *);
 bool vm_supt_install_frame (struct supplemental_page_table *supt, void *upage, void *kpage);
 bool vm_supt_install_zeropage (struct supplemental_page_table *supt, void *);
 bool vm_supt_set_swap (struct supplemental_page_table *supt, void *, swap_index_t);
-bool vm_supt_install_filesys (struct supplemental_page_table *supt, void *page,
-    struct file * file, off_t offset, uint32_t read_bytes, uint32_t zero_bytes, bool writable);
+bool vm_supt_install_region (struct supplemental_page_table *supt, void *upage,
+    struct file * file, off_t offset, uint32_t read_bytes, uint32_t zero_bytes, bool writable,
+    enum vm_region_type type);
+bool vm_supt_install_shm (struct supplemental_page_table *supt, void *upage,
+    size_t page_cnt, struct vm_shm *shm);
+bool vm_supt_range_is_free (struct supplemental_page_table *supt, void *start, void *end);
+bool vm_supt_remove_range (struct supplemental_page_table *supt, void *start, void *end);
+void vm_supt_resize_region (struct supplemental_page_table *supt, void *start, void *end);
+bool vm_supt_grow_stack (struct supplemental_page_table *supt, void *upage);
 
 struct supplemental_page_table_entry* vm_supt_lookup (struct supplemental_page_table *supt, void *);
 bool vm_supt_has_entry (struct supplemental_page_table *, void *page);
@@ -67,8 +154,21 @@ bool vm_supt_set_dirty (struct supplemental_page_table *supt, void *, bool);
 static bool vm_load_page_from_filesys(struct supplemental_page_table_entry *, void *);
 bool vm_load_page(struct supplemental_page_table *supt, uint32_t *pagedir, void *upage);
 
+bool vm_supt_break_cow (struct supplemental_page_table *, uint32_t *pagedir, void *upage);
+
+struct thread;
+bool vm_supt_fork (struct supplemental_page_table *dst, uint32_t *dst_pagedir,
+    struct thread *child, struct supplemental_page_table *src, uint32_t *src_pagedir,
+    struct file *(*translate) (struct file *, void *aux), void *aux);
+
+void vm_supt_drop_readahead (struct supplemental_page_table *, struct file *);
+
 bool vm_supt_mm_unmap(struct supplemental_page_table *supt, uint32_t *pagedir,
     void *page, struct file *f, off_t offset, size_t bytes);
+void vm_supt_msync (struct supplemental_page_table *supt, uint32_t *pagedir,
+    void *page, struct file *f, off_t offset, size_t bytes);
+bool vm_supt_advise (struct supplemental_page_table *supt, uint32_t *pagedir,
+    void *start, void *end, int advice);
 
 void vm_pin_page(struct supplemental_page_table *supt, void *page);
 void vm_unpin_page(struct supplemental_page_table *supt, void *page);
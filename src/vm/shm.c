@@ -0,0 +1,235 @@
+#include <list.h>
+#include <string.h>
+
+#include "vm/shm.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+
+/* Locking: shm_list_lock protects the list of segments, and is taken
+   before the lock of a segment, never the other way round. The lock
+   of a segment is held while one of its pages is brought in, so the
+   frame code must not wait for it: it only ever tries it (see
+   frame_claim()). */
+static struct lock shm_list_lock;
+
+/* The segments in use, each mapped at least once. */
+static struct list shm_list;
+
+/* Shared memory init. */
+void
+vm_shm_init (void)
+{
+  lock_init (&shm_list_lock);
+  lock_register (&shm_list_lock, "shm list");
+  list_init (&shm_list);
+}
+
+/* Returns a reference to the segment named KEY, creating it, all
+   zero, if nobody maps it. The segment must have at least PAGE_CNT
+   pages. Returns NULL if it is too small, or if out of memory. */
+struct vm_shm *
+vm_shm_open (int key, size_t page_cnt)
+{
+  struct vm_shm *shm = NULL;
+  struct list_elem *e;
+
+  ASSERT (page_cnt > 0);
+
+  lock_acquire (&shm_list_lock);
+  for (e = list_begin (&shm_list); e != list_end (&shm_list); e = list_next (e))
+    if (list_entry (e, struct vm_shm, elem)->key == key)
+      {
+        shm = list_entry (e, struct vm_shm, elem);
+        break;
+      }
+
+  if (shm != NULL)
+    {
+      bool fits;
+
+      lock_acquire (&shm->lock);
+      fits = page_cnt <= shm->page_cnt;
+      if (fits)
+        shm->ref_cnt++;
+      lock_release (&shm->lock);
+      if (!fits)
+        shm = NULL;
+    }
+  else
+    {
+      shm = malloc (sizeof *shm);
+      if (shm != NULL)
+        {
+          shm->pages = calloc (page_cnt, sizeof *shm->pages);
+          if (shm->pages == NULL)
+            {
+              free (shm);
+              shm = NULL;
+            }
+        }
+      if (shm != NULL)
+        {
+          shm->key = key;
+          shm->page_cnt = page_cnt;
+          shm->ref_cnt = 1;
+          lock_init (&shm->lock);
+          list_push_back (&shm_list, &shm->elem);
+        }
+    }
+  lock_release (&shm_list_lock);
+  return shm;
+}
+
+/* Returns one more reference to SHM, for a fork()ed child. */
+struct vm_shm *
+vm_shm_reopen (struct vm_shm *shm)
+{
+  lock_acquire (&shm->lock);
+  ASSERT (shm->ref_cnt > 0);
+  shm->ref_cnt++;
+  lock_release (&shm->lock);
+  return shm;
+}
+
+/* Drops a reference to SHM, whose pages the caller has all unmapped
+   (vm_shm_unmap_page). The segment, and its contents, are gone with
+   the last one. */
+void
+vm_shm_close (struct vm_shm *shm)
+{
+  size_t i;
+  bool last;
+
+  lock_acquire (&shm_list_lock);
+  lock_acquire (&shm->lock);
+  last = --shm->ref_cnt == 0;
+  if (last)
+    list_remove (&shm->elem);
+  lock_release (&shm->lock);
+  lock_release (&shm_list_lock);
+
+  if (!last)
+    return;
+
+  for (i = 0; i < shm->page_cnt; i++)
+    {
+      ASSERT (shm->pages[i].kpage == NULL);
+      if (shm->pages[i].swapped)
+        vm_swap_free (shm->pages[i].swap_index);
+    }
+  free (shm->pages);
+  free (shm);
+}
+
+/* Map page PAGE of SHM at UPAGE in PAGEDIR, the page directory of
+   the current process: share the frame it is in if some other
+   mapping brought it in, read it back from swap or give it a zeroed
+   frame otherwise. If PIN, the frame is left pinned. Returns false
+   if out of memory. */
+bool
+vm_shm_load_page (struct vm_shm *shm, size_t page, uint32_t *pagedir,
+    void *upage, bool pin)
+{
+  struct vm_shm_page *p = &shm->pages[page];
+  struct thread *cur = thread_current ();
+  bool success = true;
+
+  ASSERT (page < shm->page_cnt);
+
+  lock_acquire (&shm->lock);
+  if (p->kpage == NULL)
+    {
+      void *kpage = vm_frame_allocate (p->swapped ? 0 : PAL_ZERO, upage);
+      if (kpage == NULL)
+        success = false;
+      else
+        {
+          if (p->swapped)
+            vm_swap_in (p->swap_index, kpage);
+          if (!pagedir_set_page (pagedir, upage, kpage, true))
+            {
+              /* don't lose the contents. */
+              if (p->swapped)
+                p->swap_index = vm_swap_out (kpage);
+              vm_frame_free (kpage);
+              success = false;
+            }
+          else
+            {
+              vm_frame_set_shm (kpage, shm, page);
+              p->kpage = kpage;
+              p->swapped = false;
+              if (!pin)
+                vm_frame_unpin (kpage);
+            }
+        }
+    }
+  else if (!vm_frame_is_owner (p->kpage, cur, upage))
+    {
+      if (!vm_frame_share (p->kpage, cur, upage))
+        success = false;
+      else if (!pagedir_set_page (pagedir, upage, p->kpage, true))
+        {
+          vm_frame_unshare (p->kpage, cur, upage);
+          success = false;
+        }
+      else if (pin)
+        vm_frame_pin (p->kpage);
+    }
+  else if (pin)
+    vm_frame_pin (p->kpage);
+  lock_release (&shm->lock);
+  return success;
+}
+
+/* Unpin page PAGE of SHM, pinned by vm_shm_load_page(). */
+void
+vm_shm_unpin_page (struct vm_shm *shm, size_t page)
+{
+  lock_acquire (&shm->lock);
+  if (shm->pages[page].kpage != NULL)
+    vm_frame_unpin (shm->pages[page].kpage);
+  lock_release (&shm->lock);
+}
+
+/* The current process stops mapping page PAGE of SHM at UPAGE; its
+   page table entry must be cleared already. The frame goes with the
+   last of its owners, the page being saved to swap if some other
+   mapping of the segment may still want it. */
+void
+vm_shm_unmap_page (struct vm_shm *shm, size_t page, void *upage)
+{
+  struct vm_shm_page *p = &shm->pages[page];
+  struct thread *cur = thread_current ();
+
+  lock_acquire (&shm->lock);
+  if (p->kpage != NULL && vm_frame_is_owner (p->kpage, cur, upage)
+      && !vm_frame_unshare (p->kpage, cur, upage))
+    {
+      if (shm->ref_cnt > 1)
+        {
+          p->swap_index = vm_swap_out (p->kpage);
+          p->swapped = true;
+        }
+      vm_frame_free (p->kpage);
+      p->kpage = NULL;
+    }
+  lock_release (&shm->lock);
+}
+
+/* Page PAGE of SHM has been evicted to swap slot SWAP_INDEX, and is
+   mapped nowhere anymore. MUST BE CALLED with the lock of SHM held. */
+void
+vm_shm_set_swap (struct vm_shm *shm, size_t page, swap_index_t swap_index)
+{
+  ASSERT (lock_held_by_current_thread (&shm->lock));
+
+  shm->pages[page].kpage = NULL;
+  shm->pages[page].swapped = true;
+  shm->pages[page].swap_index = swap_index;
+}
@@ -0,0 +1,54 @@
+#ifndef VM_SHM_H
+#define VM_SHM_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/synch.h"
+#include "vm/swap.h"
+
+/** Where a page of a shared memory segment is. */
+struct vm_shm_page
+  {
+    void *kpage;              /**< Frame holding the page, or NULL. */
+    bool swapped;             /**< Not in a frame: in swap slot SWAP_INDEX
+                                 if true, all zero otherwise. */
+    swap_index_t swap_index;
+  };
+
+/**
+  A shared memory segment: anonymous memory that several processes
+  map at once (see shm_map()), found by its key.
+
+  The segment, not the SPTEs of the processes mapping it, knows where
+  each of its pages is. A page in memory sits in one frame, owned by
+  every (thread, upage) through which it is mapped (see
+  vm_frame_share()); when that frame is evicted, all of its mappings
+  go at once and the page goes to a single swap slot, recorded here.
+  Each process finds the page again through the segment on its next
+  fault.
+ */
+struct vm_shm
+  {
+    int key;
+    size_t page_cnt;
+    int ref_cnt;              /**< Mappings of the segment. */
+    struct lock lock;         /**< Protects the members above and below,
+                                 and the owners of the frames of PAGES. */
+    struct list_elem elem;
+    struct vm_shm_page *pages;
+  };
+
+void vm_shm_init (void);
+struct vm_shm *vm_shm_open (int key, size_t page_cnt);
+struct vm_shm *vm_shm_reopen (struct vm_shm *);
+void vm_shm_close (struct vm_shm *);
+
+bool vm_shm_load_page (struct vm_shm *, size_t page, uint32_t *pagedir,
+    void *upage, bool pin);
+void vm_shm_unpin_page (struct vm_shm *, size_t page);
+void vm_shm_unmap_page (struct vm_shm *, size_t page, void *upage);
+void vm_shm_set_swap (struct vm_shm *, size_t page, swap_index_t);
+
+#endif /**< vm/shm.h */
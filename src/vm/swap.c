@@ -1,11 +1,17 @@
 #include <bitmap.h>
+#include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "devices/block.h"
+#include "filesys/file.h"
 #include "vm/swap.h"
 #include <stdio.h>
 static struct block *swap_block;
 static struct bitmap *swap_available;
 
+/* Protects swap_available: a slot is picked and taken in one step,
+   whoever swaps out, evictor or not. Not held across the disk I/O. */
+static struct lock swap_lock;
+
 static const size_t SECTORS_PER_PAGE = PGSIZE / BLOCK_SECTOR_SIZE;
 
 /* the number of possible (swapped) pages. */
@@ -31,6 +37,8 @@ vm_swap_init ()
   swap_size = block_size(swap_block) / SECTORS_PER_PAGE;
   swap_available = bitmap_create(swap_size);
   bitmap_set_all(swap_available, true);
+  lock_init (&swap_lock);
+  lock_register (&swap_lock, "swap table");
 }
 
 /** Swap from kernel virtual address to swap slot. */
@@ -40,8 +48,13 @@ vm_swap_out (void *page)
   /* Ensure that the page is on kernel's virtual memory. */
   ASSERT (page >= PHYS_BASE);
   
-  /* Find an available block region to use */
-  size_t swap_index = bitmap_scan (swap_available, /*start*/0, /*cnt*/1, true);
+  /* Find an available block region to use, and occupy it:
+    available becomes false */
+  lock_acquire (&swap_lock);
+  size_t swap_index = bitmap_scan_and_flip (swap_available, /*start*/0, /*cnt*/1, true);
+  lock_release (&swap_lock);
+  if (swap_index == BITMAP_ERROR)
+    PANIC ("Error, swap disk is full");
 
   size_t i;
   for (i = 0; i < SECTORS_PER_PAGE; ++ i) {
@@ -51,14 +64,21 @@ vm_swap_out (void *page)
         );
   }
 
-  /* occupy the slot: available becomes false */
-  bitmap_set(swap_available, swap_index, false);
   return swap_index;
 }
 
 /** Swap from swap slot to kernel virtual address. */
 void 
 vm_swap_in (swap_index_t swap_index, void *page)
+{
+  vm_swap_read (swap_index, page);
+  vm_swap_free (swap_index);
+}
+
+/** Copy a swap slot to kernel virtual address, leaving the slot
+  occupied (e.g. fork() duplicating a swapped-out page). */
+void
+vm_swap_read (swap_index_t swap_index, void *page)
 {
   /* Ensure that the page is on kernel's virtual memory. */
   ASSERT (page >= PHYS_BASE);
@@ -78,8 +98,56 @@ vm_swap_in (swap_index_t swap_index, void *page)
         /* target address */ page + (BLOCK_SECTOR_SIZE * i)
         );
   }
+}
 
-  bitmap_set(swap_available, swap_index, true);
+/** Swap CNT consecutive slots into the kernel pages PAGES[],
+  issuing one multi-sector read for the whole run. */
+void
+vm_swap_in_multi (swap_index_t swap_index, size_t cnt, void *pages[])
+{
+  void *sectors[cnt * SECTORS_PER_PAGE];
+  size_t i, j;
+
+  ASSERT (cnt > 0);
+  ASSERT (swap_index + cnt <= swap_size);
+
+  for (i = 0; i < cnt; ++ i)
+  {
+    /* Ensure that the page is on kernel's virtual memory. */
+    ASSERT (pages[i] >= PHYS_BASE);
+    if (bitmap_test(swap_available, swap_index + i) == true) {
+      /* still available slot, error */
+      PANIC ("Error, invalid read access to unassigned swap block");
+    }
+
+    for (j = 0; j < SECTORS_PER_PAGE; ++ j)
+      sectors[i * SECTORS_PER_PAGE + j] = pages[i] + (BLOCK_SECTOR_SIZE * j);
+  }
+
+  block_read_multi (swap_block, swap_index * SECTORS_PER_PAGE,
+                    cnt * SECTORS_PER_PAGE, sectors);
+
+  lock_acquire (&swap_lock);
+  bitmap_set_multiple(swap_available, swap_index, cnt, true);
+  lock_release (&swap_lock);
+}
+
+/** Write a swap slot back to the file it caches, e.g. a dirty page
+  of a memory mapped file, without a kernel page to bounce through. */
+void
+vm_swap_write_to_file (swap_index_t swap_index, struct file *file,
+    off_t offset, size_t bytes)
+{
+  /* check the swap region */
+  ASSERT (swap_index < swap_size);
+  ASSERT (bytes <= PGSIZE);
+  if (bitmap_test(swap_available, swap_index) == true) {
+    /* still available slot, error */
+    PANIC ("Error, invalid read access to unassigned swap block");
+  }
+
+  file_write_from_block (file, offset, swap_block,
+                         swap_index * SECTORS_PER_PAGE, bytes);
 }
 
 void
@@ -87,9 +155,11 @@ vm_swap_free (swap_index_t swap_index)
 {
   /* check the swap region */
   ASSERT (swap_index < swap_size);
+  lock_acquire (&swap_lock);
   if (bitmap_test(swap_available, swap_index) == true) 
   {
     PANIC ("Error, invalid free request to unassigned swap block");
   }
   bitmap_set(swap_available, swap_index, true);
+  lock_release (&swap_lock);
 }
@@ -1,6 +1,12 @@
 #ifndef VM_SWAP_H
 #define VM_SWAP_H
 
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct file;
+
 typedef uint32_t swap_index_t;
 
 
@@ -23,6 +29,27 @@ swap_index_t vm_swap_out (void *page);
  */
 void vm_swap_in (swap_index_t swap_index, void *page);
 
+/**
+  Read the content of the specified swap slot into `page`,
+  like vm_swap_in(), but keep the slot allocated.
+ */
+void vm_swap_read (swap_index_t swap_index, void *page);
+
+/**
+  Swap In (readahead): read CNT consecutive swap slots starting at
+  `swap_index` with a single multi-sector request, storing the
+  I-th slot into `pages[I]`.
+ */
+void vm_swap_in_multi (swap_index_t swap_index, size_t cnt, void *pages[]);
+
+/**
+  Write back: write the first BYTES bytes of the specified swap slot
+  into FILE at OFFSET, straight from the swap disk into the file,
+  and keep the slot allocated.
+ */
+void vm_swap_write_to_file (swap_index_t swap_index, struct file *file,
+    off_t offset, size_t bytes);
+
 /**
   Free Swap: drop the swap region.
  */